@@ -0,0 +1,426 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <assert.h>
+
+#include "backlog_event_dispatcher.h"
+#include "metrics.h"
+
+static bool backlog_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count);
+static void backlog_event_dispatcher_destroy(struct event_dispatcher *base);
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool backlog_event_dispatcher_create(struct backlog_event_dispatcher *self, struct event_dispatcher *next,
+		int fd, bool priority)
+{
+	assert(self != NULL);
+	assert(next != NULL);
+	self->base.dispatch = backlog_event_dispatcher_dispatch;
+	self->base.destroy = backlog_event_dispatcher_destroy;
+
+	self->next = next;
+	self->fd = fd;
+	self->priority = priority;
+	self->metrics = NULL;
+
+	self->slot = 0;
+	self->frame_count = 0;
+	self->event_count = 0;
+
+	self->frames_in = 0;
+	self->frames_collapsed = 0;
+	self->blocking_writes = 0;
+	self->state_frames = 0;
+	self->state_latency_us = 0;
+	self->max_state_latency_us = 0;
+	self->max_depth = 0;
+
+	return true;
+}
+
+static bool output_ready(const struct backlog_event_dispatcher *self)
+{
+	struct pollfd p;
+	p.fd = self->fd;
+	p.events = POLLOUT;
+	p.revents = 0;
+
+	// an error is reported by the write itself
+	return poll(&p, 1, 0) > 0;
+}
+
+static bool write_frame(struct backlog_event_dispatcher *self, const struct backlog_frame *frame)
+{
+	if (!self->next->dispatch(self->next, &self->events[frame->first], frame->count))
+		return false;
+
+	if (frame->complete && !frame->motion_only)
+	{
+		const int64_t latency = now_us() - frame->queued_us;
+		++self->state_frames;
+		self->state_latency_us += latency;
+		if (latency > self->max_state_latency_us)
+			self->max_state_latency_us = latency;
+	}
+	return true;
+}
+
+/**
+ * Forget the first \a n frames, they have been written.
+ */
+static void remove_frames(struct backlog_event_dispatcher *self, int n)
+{
+	if (n == 0)
+		return;
+
+	const int removed_events = n < self->frame_count ? self->frames[n].first : self->event_count;
+	memmove(self->events, self->events + removed_events, sizeof(self->events[0]) * (self->event_count - removed_events));
+	self->event_count -= removed_events;
+
+	memmove(self->frames, self->frames + n, sizeof(self->frames[0]) * (self->frame_count - n));
+	self->frame_count -= n;
+	for (int i = 0; i < self->frame_count; ++i)
+		self->frames[i].first -= removed_events;
+}
+
+/**
+ * Publish the queue state, every dispatch ends with a flush that calls this.
+ */
+static void update_metrics(struct backlog_event_dispatcher *self)
+{
+	if (!self->metrics)
+		return;
+
+	metrics_set(&self->metrics->frames, self->frame_count);
+	metrics_set(&self->metrics->events, self->event_count);
+	metrics_set(&self->metrics->frames_collapsed, self->frames_collapsed);
+}
+
+static int complete_frames(const struct backlog_event_dispatcher *self)
+{
+	const int n = self->frame_count;
+	return (n > 0 && !self->frames[n - 1].complete) ? n - 1 : n;
+}
+
+bool backlog_event_dispatcher_pending(const struct backlog_event_dispatcher *self)
+{
+	assert(self != NULL);
+	return complete_frames(self) > 0;
+}
+
+bool backlog_event_dispatcher_flush(struct backlog_event_dispatcher *self)
+{
+	assert(self != NULL);
+
+	const int count = complete_frames(self);
+	int n = 0;
+	bool ok = true;
+	while (n < count && output_ready(self))
+	{
+		ok = write_frame(self, &self->frames[n++]);
+		if (!ok)
+			break;
+	}
+
+	remove_frames(self, n);
+	update_metrics(self);
+	return ok;
+}
+
+/**
+ * Replace the complete motion-only frames [\a first, \a last) by a single
+ * frame carrying the newest value of every axis they touch.
+ */
+static void collapse_frames(struct backlog_event_dispatcher *self, int first, int last)
+{
+	if (last - first < 2)
+		return;
+
+	struct backlog_frame *a = &self->frames[first];
+	const struct backlog_frame *b = &self->frames[last - 1];
+	const int begin = a->first;
+	const int end = b->first + b->count;
+
+	memset(self->slot_mask, 0, sizeof(self->slot_mask));
+	self->abs_set = 0;
+	self->msc_set = 0;
+
+	int slot = a->start_slot;
+	struct timeval time = self->events[end - 1].time;
+	for (int i = begin; i < end; ++i)
+	{
+		const struct input_event *ev = &self->events[i];
+		if (ev->type == EV_ABS)
+		{
+			if (ev->code == ABS_MT_SLOT)
+				slot = ev->value;
+			else if (ev->code > ABS_MT_SLOT)
+			{
+				uint64_t *word = &self->slot_mask[slot / 64];
+				const uint64_t bit = (uint64_t)1 << (slot % 64);
+				if (!(*word & bit))
+				{
+					*word |= bit;
+					self->mt_set[slot] = 0;
+				}
+				self->mt_values[slot][ev->code - ABS_MT_SLOT - 1] = ev->value;
+				self->mt_set[slot] |= 1u << (ev->code - ABS_MT_SLOT - 1);
+			}
+			else
+			{
+				self->abs_values[ev->code] = ev->value;
+				self->abs_set |= (uint64_t)1 << ev->code;
+			}
+		}
+		else if (ev->type == EV_MSC && ev->code < MSC_CNT)
+		{
+			self->msc_values[ev->code] = ev->value;
+			self->msc_set |= 1u << ev->code;
+		}
+	}
+	const int end_slot = slot;
+
+	struct input_event *collapsed = self->collapsed;
+	int n = 0;
+#define EMIT(t, c, v) do { collapsed[n].time = time; collapsed[n].type = (t); collapsed[n].code = (c); collapsed[n].value = (v); ++n; } while (0)
+
+	int out_slot = a->start_slot;
+	for (int s = 0; s < BACKLOG_MAX_SLOTS; ++s)
+	{
+		if (!(self->slot_mask[s / 64] & ((uint64_t)1 << (s % 64))))
+			continue;
+
+		if (s != out_slot)
+		{
+			EMIT(EV_ABS, ABS_MT_SLOT, s);
+			out_slot = s;
+		}
+		for (int axis = 0; axis < BACKLOG_MT_AXES; ++axis)
+		{
+			if (self->mt_set[s] & (1u << axis))
+				EMIT(EV_ABS, ABS_MT_SLOT + 1 + axis, self->mt_values[s][axis]);
+		}
+	}
+	// the frames behind continue in the slot the collapsed ones ended in
+	if (out_slot != end_slot)
+		EMIT(EV_ABS, ABS_MT_SLOT, end_slot);
+
+	for (int code = 0; code < ABS_MT_SLOT; ++code)
+	{
+		if (self->abs_set & ((uint64_t)1 << code))
+			EMIT(EV_ABS, code, self->abs_values[code]);
+	}
+	for (int code = 0; code < MSC_CNT; ++code)
+	{
+		if (self->msc_set & (1u << code))
+			EMIT(EV_MSC, code, self->msc_values[code]);
+	}
+	EMIT(EV_SYN, SYN_REPORT, 0);
+#undef EMIT
+
+	assert(n <= BACKLOG_MAX_COLLAPSED);
+	const int delta = n - (end - begin);
+	if (self->event_count + delta > BACKLOG_MAX_EVENTS)
+		return;
+
+	memmove(self->events + begin + n, self->events + end, sizeof(self->events[0]) * (self->event_count - end));
+	memcpy(self->events + begin, collapsed, sizeof(collapsed[0]) * n);
+	self->event_count += delta;
+
+	// the collapsed frame keeps the queue time of the oldest one
+	a->count = n;
+	const int removed = last - first - 1;
+	memmove(self->frames + first + 1, self->frames + last, sizeof(self->frames[0]) * (self->frame_count - last));
+	self->frame_count -= removed;
+	for (int i = first + 1; i < self->frame_count; ++i)
+		self->frames[i].first += delta;
+
+	self->frames_collapsed += removed + 1;
+}
+
+/**
+ * Collapse the run of motion-only frames in front of frame \a index.
+ */
+static void collapse_before(struct backlog_event_dispatcher *self, int index)
+{
+	int first = index;
+	while (first > 0 && self->frames[first - 1].complete && self->frames[first - 1].motion_only)
+		--first;
+
+	collapse_frames(self, first, index);
+}
+
+static bool make_room(struct backlog_event_dispatcher *self)
+{
+	if (self->priority)
+		collapse_before(self, complete_frames(self));
+
+	if (self->frame_count < BACKLOG_MAX_FRAMES && self->event_count < BACKLOG_MAX_EVENTS)
+		return true;
+
+	// the output is hopelessly behind, wait for it to take half of the queue
+	int n = 0;
+	while (n < self->frame_count && (self->frame_count - n > BACKLOG_MAX_FRAMES / 2 ||
+			self->event_count - self->frames[n].first > BACKLOG_MAX_EVENTS / 2))
+	{
+		++self->blocking_writes;
+		if (!write_frame(self, &self->frames[n++]))
+		{
+			remove_frames(self, n);
+			return false;
+		}
+	}
+	remove_frames(self, n);
+	return true;
+}
+
+static struct backlog_frame *open_frame(struct backlog_event_dispatcher *self)
+{
+	struct backlog_frame *f = &self->frames[self->frame_count++];
+	f->first = self->event_count;
+	f->count = 0;
+	f->start_slot = self->slot;
+	f->complete = false;
+	f->motion_only = true;
+	f->queued_us = 0;
+	return f;
+}
+
+static bool is_motion(const struct backlog_event_dispatcher *self, const struct input_event *ev)
+{
+	switch (ev->type)
+	{
+	case EV_SYN:
+		return ev->code == SYN_REPORT;
+	case EV_MSC:
+		return true;
+	case EV_ABS:
+		if (ev->code == ABS_MT_TRACKING_ID)
+			return false;
+		if (ev->code >= ABS_MT_SLOT)
+			return self->slot >= 0 && self->slot < BACKLOG_MAX_SLOTS;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool backlog_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	assert(base != NULL);
+	struct backlog_event_dispatcher* const self = (struct backlog_event_dispatcher*)base;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const struct input_event *ev = &events[i];
+
+		const bool need_frame = self->frame_count == 0 || self->frames[self->frame_count - 1].complete;
+		if ((need_frame && self->frame_count == BACKLOG_MAX_FRAMES) || self->event_count == BACKLOG_MAX_EVENTS)
+		{
+			if (!make_room(self))
+			{
+				update_metrics(self);
+				return false;
+			}
+		}
+
+		struct backlog_frame *f;
+		if (self->frame_count == 0 || self->frames[self->frame_count - 1].complete)
+			f = open_frame(self);
+		else
+			f = &self->frames[self->frame_count - 1];
+
+		if (ev->type == EV_ABS && ev->code == ABS_MT_SLOT)
+			self->slot = ev->value;
+		if (!is_motion(self, ev))
+			f->motion_only = false;
+
+		self->events[self->event_count++] = *ev;
+		++f->count;
+
+		if (ev->type != EV_SYN || ev->code != SYN_REPORT)
+			continue;
+
+		f->complete = true;
+		f->queued_us = now_us();
+		++self->frames_in;
+
+		const int index = self->frame_count - 1;
+
+		// state changes overtake the motion queued since the previous one
+		if (self->priority && !f->motion_only)
+			collapse_before(self, index);
+
+		if (self->frame_count > self->max_depth)
+			self->max_depth = self->frame_count;
+	}
+
+	return backlog_event_dispatcher_flush(self);
+}
+
+static void backlog_event_dispatcher_destroy(struct event_dispatcher *base)
+{
+	assert(base != NULL);
+	struct backlog_event_dispatcher* const self = (struct backlog_event_dispatcher*)base;
+
+	// whatever is left goes out, waiting for the output if need be
+	int n = 0;
+	while (n < self->frame_count && write_frame(self, &self->frames[n]))
+		++n;
+	remove_frames(self, n);
+	update_metrics(self);
+
+	self->next->destroy(self->next);
+	free(self->next);
+}
+
+void backlog_event_dispatcher_print_stats(const struct backlog_event_dispatcher *self, FILE *f)
+{
+	assert(self != NULL);
+
+	fprintf(f, "backlog%s: %llu frames, %llu collapsed, %llu blocking writes, max depth %d\n",
+		self->priority ? " (priority lane)" : "",
+		(unsigned long long)self->frames_in,
+		(unsigned long long)self->frames_collapsed, (unsigned long long)self->blocking_writes, self->max_depth);
+	if (self->state_frames > 0)
+	{
+		fprintf(f, "backlog: state change frames waited %.0f us on average, %lld us at most\n",
+			(double)self->state_latency_us / self->state_frames, (long long)self->max_state_latency_us);
+	}
+}
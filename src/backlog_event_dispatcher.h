@@ -0,0 +1,132 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#ifndef BACKLOG_EVENT_DISPATCHER_H
+#define BACKLOG_EVENT_DISPATCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "event_dispatcher.h"
+
+struct metrics_queue;
+
+#define BACKLOG_MAX_FRAMES 256
+#define BACKLOG_MAX_EVENTS 8192
+
+/**
+ * \brief Slots whose motion can be collapsed, as many as the panel merger produces; frames touching higher slots are never collapsed.
+ */
+#define BACKLOG_MAX_SLOTS 256
+
+// per-contact axes following ABS_MT_SLOT
+#define BACKLOG_MT_AXES (ABS_MAX - ABS_MT_SLOT)
+
+// upper bound of the events of a collapsed frame
+#define BACKLOG_MAX_COLLAPSED (BACKLOG_MAX_SLOTS * (BACKLOG_MT_AXES + 1) + 1 + ABS_MT_SLOT + MSC_CNT + 1)
+
+struct backlog_frame
+{
+	int first, count; // events of the frame
+	int start_slot; // MT slot in effect before the frame
+	bool complete; // ends with SYN_REPORT
+	bool motion_only; // nothing but absolute axes other than the tracking ID and MSC events
+	int64_t queued_us;
+};
+
+/**
+ * \brief Pipeline stage that keeps the frames the output can't take yet.
+ *
+ * Frames are passed to \a next only when \a fd polls writable, otherwise
+ * they queue up and translate_loop() waits for POLLOUT on \a fd to flush
+ * them. When the queue is full the stage falls back to a blocking write.
+ *
+ * With the priority lane on, a frame that changes contact state (tracking
+ * ID, keys, anything but motion) overtakes the motion-only frames queued
+ * since the previous such frame: they are collapsed into one frame that
+ * carries their newest values and goes out just ahead of it. The consumer
+ * sees the same final state, only the stale intermediate positions are
+ * dropped, so taps and releases no longer wait behind a long motion tail.
+ *
+ * The stage owns \a next and destroys it in its own destroy, after
+ * writing out what is left in the queue.
+ */
+struct backlog_event_dispatcher
+{
+	struct event_dispatcher base;
+	struct event_dispatcher *next;
+	int fd;
+	bool priority;
+	struct metrics_queue *metrics; // NULL when not collected
+
+	int slot; // MT slot at the end of the queued stream
+
+	int frame_count;
+	struct backlog_frame frames[BACKLOG_MAX_FRAMES];
+	int event_count;
+	struct input_event events[BACKLOG_MAX_EVENTS];
+
+	// collapsing state
+	uint64_t slot_mask[BACKLOG_MAX_SLOTS / 64];
+	int32_t mt_values[BACKLOG_MAX_SLOTS][BACKLOG_MT_AXES];
+	uint32_t mt_set[BACKLOG_MAX_SLOTS];
+	int32_t abs_values[ABS_MT_SLOT];
+	uint64_t abs_set;
+	int32_t msc_values[MSC_CNT];
+	uint32_t msc_set;
+	struct input_event collapsed[BACKLOG_MAX_COLLAPSED];
+
+	// statistics
+	uint64_t frames_in;
+	uint64_t frames_collapsed;
+	uint64_t blocking_writes;
+	uint64_t state_frames;
+	int64_t state_latency_us; // queued to written, summed over the state frames
+	int64_t max_state_latency_us;
+	int max_depth;
+};
+
+/**
+ * \brief Create the backlog in front of \a next which writes to \a fd.
+ */
+bool backlog_event_dispatcher_create(struct backlog_event_dispatcher *self, struct event_dispatcher *next,
+		int fd, bool priority);
+
+/**
+ * \brief True if there are complete frames waiting for the output.
+ */
+bool backlog_event_dispatcher_pending(const struct backlog_event_dispatcher *self);
+
+/**
+ * \brief Write queued frames for as long as the output takes them without blocking.
+ */
+bool backlog_event_dispatcher_flush(struct backlog_event_dispatcher *self);
+
+void backlog_event_dispatcher_print_stats(const struct backlog_event_dispatcher *self, FILE *f);
+
+#endif // BACKLOG_EVENT_DISPATCHER_H
@@ -0,0 +1,152 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "deadband_event_dispatcher.h"
+
+static void deadband_process(struct slot_filter *base, const struct timeval *time);
+
+bool deadband_config_parse(struct deadband_config *config, const char *s)
+{
+	assert(config != NULL);
+	char *end;
+	config->x = strtod(s, &end);
+	if (end == s)
+		return false;
+
+	s = end;
+	config->y = config->x;
+	if (*s == ',')
+	{
+		++s;
+		config->y = strtod(s, &end);
+		if (end == s)
+			return false;
+		s = end;
+	}
+
+	config->in_mm = strcmp(s, "mm") == 0;
+	if (!config->in_mm && *s != '\0')
+		return false;
+
+	return config->x >= 0 && config->y >= 0;
+}
+
+static bool get_threshold(int *threshold, double value, bool in_mm, const struct input_absinfo *axis)
+{
+	if (in_mm)
+	{
+		if (axis->resolution <= 0)
+		{
+			fprintf(stderr, "deadband_event_dispatcher_create: device reports no resolution, give the deadband in device units\n");
+			return false;
+		}
+		// resolution is in units per millimetre
+		value *= axis->resolution;
+	}
+
+	*threshold = (int)(value + 0.5);
+	return true;
+}
+
+bool deadband_event_dispatcher_create(struct deadband_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		const struct deadband_config *config, const struct input_absinfo *absinfo, bool timed)
+{
+	assert(self != NULL);
+	assert(config != NULL);
+	assert(absinfo != NULL);
+
+	if (!get_threshold(&self->threshold_x, config->x, config->in_mm, &absinfo[ABS_MT_POSITION_X]) ||
+			!get_threshold(&self->threshold_y, config->y, config->in_mm, &absinfo[ABS_MT_POSITION_Y]))
+		return false;
+
+	// the pointer axes only matter on devices that have them
+	self->pointer_threshold_x = self->threshold_x;
+	self->pointer_threshold_y = self->threshold_y;
+	if (config->in_mm && absinfo[ABS_X].resolution > 0 && absinfo[ABS_Y].resolution > 0)
+	{
+		get_threshold(&self->pointer_threshold_x, config->x, true, &absinfo[ABS_X]);
+		get_threshold(&self->pointer_threshold_y, config->y, true, &absinfo[ABS_Y]);
+	}
+
+	if (!slot_filter_init(&self->base, next, slot_count, deadband_process, NULL))
+		return false;
+	self->base.timed = timed;
+
+	return true;
+}
+
+static int apply_deadband(int in, int sent, int threshold)
+{
+	// nothing sent yet for this contact
+	if (sent == INT_MIN)
+		return in;
+
+	const int delta = in - sent;
+	return (delta > threshold || delta < -threshold) ? in : sent;
+}
+
+static void deadband_process(struct slot_filter *base, const struct timeval *time)
+{
+	assert(base != NULL);
+	(void)time; // unused
+	struct deadband_event_dispatcher* const self = (struct deadband_event_dispatcher*)base;
+
+	for (int i = 0; i <= base->slot_count; ++i)
+	{
+		// contacts that did not move in this frame may still sit inside the deadband
+		struct slot_filter_contact *c = &base->contacts[slot_filter_index(base, i)];
+		if (c->tracking_id < 0)
+			continue;
+
+		const bool is_pointer = i == base->slot_count;
+		c->out_x = apply_deadband(c->in_x, c->sent_x, is_pointer ? self->pointer_threshold_x : self->threshold_x);
+		c->out_y = apply_deadband(c->in_y, c->sent_y, is_pointer ? self->pointer_threshold_y : self->threshold_y);
+	}
+}
+
+void deadband_event_dispatcher_print_stats(const struct deadband_event_dispatcher *self, FILE *f)
+{
+	assert(self != NULL);
+	const struct slot_filter_stats *stats = &self->base.stats;
+
+	fprintf(f, "deadband: %llu of %llu events passed", (unsigned long long)stats->events_out,
+		(unsigned long long)stats->events_in);
+	if (stats->events_in > 0)
+		fprintf(f, " (%.1f%% removed)", 100.0 * (stats->events_in - stats->events_out) / stats->events_in);
+	fprintf(f, ", %llu of %llu frames passed", (unsigned long long)stats->frames_out,
+		(unsigned long long)stats->frames_in);
+	if (self->base.timed && stats->frames_in > 0)
+		fprintf(f, ", %.0f ns/frame", (double)stats->ns / stats->frames_in);
+	fprintf(f, "\n");
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#ifndef DEADBAND_EVENT_DISPATCHER_H
+#define DEADBAND_EVENT_DISPATCHER_H
+
+#include <stdio.h>
+
+#include "slot_filter.h"
+
+/**
+ * \brief Size of the deadband around the last reported position, per axis.
+ *
+ * The values are in device units, or in millimetres when \a in_mm is set,
+ * in which case they are scaled by the resolution of the device.
+ */
+struct deadband_config
+{
+	double x, y;
+	bool in_mm;
+};
+
+/**
+ * \brief Parse "x[,y]" optionally followed by "mm"; a single value is used for both axes.
+ */
+bool deadband_config_parse(struct deadband_config *config, const char *s);
+
+/**
+ * \brief Pipeline stage that suppresses contact motion below a threshold.
+ *
+ * A contact keeps its last reported position on an axis until the input
+ * moves more than the threshold away from it, then the new position is
+ * reported and becomes the new anchor. Touch-down and touch-up, tracking
+ * IDs and buttons always pass; the slot_filter base drops the position
+ * events that carry nothing new and the frames that end up empty.
+ */
+struct deadband_event_dispatcher
+{
+	struct slot_filter base;
+
+	int threshold_x, threshold_y;
+	int pointer_threshold_x, pointer_threshold_y;
+};
+
+/**
+ * \brief Create the deadband stage in front of \a next for \a slot_count MT slots.
+ *
+ * \a absinfo is the ABS_CNT item table of the axis ranges of the input
+ * device, used for the resolution when the thresholds are in millimetres.
+ * With \a timed set the time spent in the stage is collected as well.
+ */
+bool deadband_event_dispatcher_create(struct deadband_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		const struct deadband_config *config, const struct input_absinfo *absinfo, bool timed);
+
+/**
+ * \brief Print how much traffic the stage removed.
+ */
+void deadband_event_dispatcher_print_stats(const struct deadband_event_dispatcher *self, FILE *f);
+
+#endif // DEADBAND_EVENT_DISPATCHER_H
@@ -0,0 +1,203 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "device_profile.h"
+#include "input_utils.h"
+
+static const char DEVICE_PROFILE_MAGIC[8] = "MTTPROF\0";
+static const uint32_t DEVICE_PROFILE_VERSION = 1;
+
+struct device_profile_file_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t size;
+};
+
+static bool get_bits(int fd, uint32_t type, uint8_t *bits, size_t size)
+{
+	if (ioctl(fd, EVIOCGBIT(type, size), bits) < 0)
+	{
+		perror("can't get device capability bits");
+		return false;
+	}
+	return true;
+}
+
+static bool get_key(int fd, struct input_id *id, char *phys)
+{
+	if (ioctl(fd, EVIOCGID, id) != 0)
+	{
+		perror("can't get device id");
+		return false;
+	}
+
+	// not all devices have a physical path
+	memset(phys, 0, DEVICE_PROFILE_STRING_SIZE);
+	if (ioctl(fd, EVIOCGPHYS(DEVICE_PROFILE_STRING_SIZE - 1), phys) < 0)
+		phys[0] = '\0';
+
+	return true;
+}
+
+bool device_profile_probe(struct device_profile *self, int fd)
+{
+	assert(self != NULL);
+	memset(self, 0, sizeof(*self));
+
+	if (!get_key(fd, &self->id, self->phys))
+		return false;
+
+	if (ioctl(fd, EVIOCGVERSION, &self->driver_version) != 0)
+	{
+		perror("can't get device version");
+		return false;
+	}
+
+	if (ioctl(fd, EVIOCGNAME(sizeof(self->name) - 1), self->name) < 0)
+		self->name[0] = '\0';
+
+	if (ioctl(fd, EVIOCGPROP(sizeof(self->prop_bits)), self->prop_bits) < 0)
+		memset(self->prop_bits, 0, sizeof(self->prop_bits));
+
+	return get_bits(fd, 0, self->ev_bits, sizeof(self->ev_bits))
+		&& get_bits(fd, EV_KEY, self->key_bits, sizeof(self->key_bits))
+		&& get_bits(fd, EV_REL, self->rel_bits, sizeof(self->rel_bits))
+		&& get_bits(fd, EV_MSC, self->msc_bits, sizeof(self->msc_bits))
+		&& get_abs_bits(fd, &self->abs_bits)
+		&& get_absinfo_table(fd, self->absinfo);
+}
+
+static char *cache_file_name(const char *dir, const struct input_id *id, const char *phys)
+{
+	// FNV-1a of the physical path
+	uint32_t hash = 2166136261u;
+	for (const char *c = phys; *c; ++c)
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+	const size_t size = strlen(dir) + 64;
+	char *name = (char*)malloc(size);
+	if (name)
+		snprintf(name, size, "%s/%04x-%04x-%04x-%04x-%08x.profile",
+				dir, id->bustype, id->vendor, id->product, id->version, hash);
+	return name;
+}
+
+bool device_profile_load(struct device_profile *self, const char *dir, int fd)
+{
+	assert(self != NULL);
+	assert(dir != NULL);
+
+	struct input_id id;
+	char phys[DEVICE_PROFILE_STRING_SIZE];
+	if (!get_key(fd, &id, phys))
+		return false;
+
+	char *name = cache_file_name(dir, &id, phys);
+	if (!name)
+		return false;
+	FILE *f = fopen(name, "rb");
+	free(name);
+	if (!f)
+		return false;
+
+	struct device_profile_file_header header;
+	const bool ok = fread(&header, sizeof(header), 1, f) == 1
+		&& memcmp(header.magic, DEVICE_PROFILE_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == DEVICE_PROFILE_VERSION
+		&& header.size == sizeof(*self)
+		&& fread(self, sizeof(*self), 1, f) == 1;
+	fclose(f);
+
+	// a different device with a colliding file name is a miss
+	return ok && memcmp(&self->id, &id, sizeof(id)) == 0 && strcmp(self->phys, phys) == 0;
+}
+
+bool device_profile_save(const struct device_profile *self, const char *dir)
+{
+	assert(self != NULL);
+	assert(dir != NULL);
+
+	char *name = cache_file_name(dir, &self->id, self->phys);
+	if (!name)
+		return false;
+
+	// write a temporary file and rename it so that a reader never sees a partial profile
+	const size_t tmp_size = strlen(name) + 8;
+	char *tmp_name = (char*)malloc(tmp_size);
+	if (!tmp_name)
+	{
+		free(name);
+		return false;
+	}
+	snprintf(tmp_name, tmp_size, "%s.tmp", name);
+
+	struct device_profile_file_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DEVICE_PROFILE_MAGIC, sizeof(header.magic));
+	header.version = DEVICE_PROFILE_VERSION;
+	header.size = sizeof(*self);
+
+	bool ok = false;
+	FILE *f = fopen(tmp_name, "wb");
+	if (f)
+	{
+		ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(self, sizeof(*self), 1, f) == 1;
+		if (fclose(f) != 0)
+			ok = false;
+		if (ok && rename(tmp_name, name) != 0)
+			ok = false;
+		if (!ok)
+			unlink(tmp_name);
+	}
+	if (!ok)
+		perror("can't write device profile");
+
+	free(tmp_name);
+	free(name);
+	return ok;
+}
+
+void device_profile_print(const struct device_profile *self)
+{
+	assert(self != NULL);
+	const int version = self->driver_version;
+	printf("input driver version: %d.%d.%d\n", version >> 16, (version >> 8) & 0xff, version & 0xff);
+	printf("input device id: bustype=0x%x, vendor=0x%x, product=0x%x, version=0x%x\n",
+			(int)self->id.bustype, (int)self->id.vendor, (int)self->id.product, (int)self->id.version);
+	printf("device name: '%s'\n", self->name);
+	printf("physical path: '%s'\n", self->phys);
+}
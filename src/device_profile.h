@@ -0,0 +1,84 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef DEVICE_PROFILE_H
+#define DEVICE_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#define DEVICE_PROFILE_STRING_SIZE 80
+
+/**
+ * \brief Everything the translator needs to know about an input device.
+ *
+ * Probing takes a few dozen ioctls. The profile can be kept in a cache
+ * directory, keyed by the device id and physical path; looking it up
+ * takes two ioctls. The cache file is the structure itself in host
+ * byte order behind a small header.
+ */
+struct device_profile
+{
+	struct input_id id;
+	int driver_version;
+	char phys[DEVICE_PROFILE_STRING_SIZE];
+	char name[DEVICE_PROFILE_STRING_SIZE];
+
+	uint8_t ev_bits[EV_MAX/8 + 1];
+	uint8_t key_bits[KEY_MAX/8 + 1];
+	uint8_t rel_bits[REL_MAX/8 + 1];
+	uint8_t msc_bits[MSC_MAX/8 + 1];
+	uint8_t prop_bits[INPUT_PROP_MAX/8 + 1];
+
+	uint64_t abs_bits;
+	struct input_absinfo absinfo[ABS_CNT];
+};
+
+static inline bool device_profile_test_bit(const uint8_t *bits, unsigned code)
+{
+	return bits[code/8] & (1 << (code%8));
+}
+
+/**
+ * \brief Query everything from the device.
+ */
+bool device_profile_probe(struct device_profile *self, int fd);
+
+/**
+ * \brief Look the device up in the cache in \a dir.
+ *
+ * \return true if a valid profile for the device was found
+ */
+bool device_profile_load(struct device_profile *self, const char *dir, int fd);
+
+bool device_profile_save(const struct device_profile *self, const char *dir);
+
+void device_profile_print(const struct device_profile *self);
+
+#endif // DEVICE_PROFILE_H
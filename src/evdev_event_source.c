@@ -0,0 +1,155 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "evdev_event_source.h"
+
+// same as the kernel's EVDEV_BUF_PACKETS and EVDEV_MIN_BUFFER_SIZE
+static const int EVDEV_BUFFER_PACKETS = 8;
+static const int EVDEV_MIN_BUFFER_SIZE = 64;
+
+static int evdev_event_source_read(struct event_source *base, const struct input_event **events);
+static void evdev_event_source_destroy(struct event_source *base);
+
+static bool is_mt_axis(unsigned code)
+{
+	// ABS_MT_SLOT and all the per-contact axes after it
+	return code >= ABS_MT_SLOT;
+}
+
+int evdev_events_per_packet(const struct device_profile *profile)
+{
+	assert(profile != NULL);
+
+	int slots = 0;
+	if ((profile->abs_bits >> ABS_MT_SLOT) & 1)
+		slots = profile->absinfo[ABS_MT_SLOT].maximum - profile->absinfo[ABS_MT_SLOT].minimum + 1;
+	else if ((profile->abs_bits >> ABS_MT_TRACKING_ID) & 1)
+	{
+		slots = profile->absinfo[ABS_MT_TRACKING_ID].maximum - profile->absinfo[ABS_MT_TRACKING_ID].minimum + 1;
+		if (slots < 2)
+			slots = 2;
+		if (slots > 32)
+			slots = 32;
+	}
+	else if ((profile->abs_bits >> ABS_MT_POSITION_X) & 1)
+		slots = 2;
+
+	// SYN_MT_REPORT and SYN_REPORT
+	int events = slots + 1;
+
+	if (device_profile_test_bit(profile->ev_bits, EV_ABS))
+	{
+		for (unsigned code = 0; code < ABS_CNT; ++code)
+		{
+			if ((profile->abs_bits >> code) & 1)
+				events += is_mt_axis(code) ? slots : 1;
+		}
+	}
+
+	if (device_profile_test_bit(profile->ev_bits, EV_REL))
+	{
+		for (unsigned code = 0; code <= REL_MAX; ++code)
+		{
+			if (device_profile_test_bit(profile->rel_bits, code))
+				++events;
+		}
+	}
+
+	// room for KEY and MSC events
+	return events + 7;
+}
+
+int evdev_buffer_size(const struct device_profile *profile)
+{
+	assert(profile != NULL);
+
+	int events = evdev_events_per_packet(profile) * EVDEV_BUFFER_PACKETS;
+	if (events < EVDEV_MIN_BUFFER_SIZE)
+		events = EVDEV_MIN_BUFFER_SIZE;
+
+	int size = 1;
+	while (size < events)
+		size <<= 1;
+	return size;
+}
+
+bool evdev_event_source_create(struct evdev_event_source *self, int fd, const struct device_profile *profile)
+{
+	assert(self != NULL);
+	assert(profile != NULL);
+	self->base.read = evdev_event_source_read;
+	self->base.destroy = evdev_event_source_destroy;
+
+	self->base.fd = fd;
+	self->base.capacity = evdev_buffer_size(profile);
+
+	self->buffer = (struct input_event*)malloc(sizeof(*self->buffer) * self->base.capacity);
+	if (!self->buffer)
+	{
+		fprintf(stderr, "evdev_event_source_create: can't allocate buffer\n");
+		return false;
+	}
+
+	return true;
+}
+
+static int evdev_event_source_read(struct event_source *base, const struct input_event **events)
+{
+	assert(base != NULL);
+	struct evdev_event_source* const self = (struct evdev_event_source*)base;
+
+	ssize_t r;
+	do
+		r = read(base->fd, self->buffer, sizeof(*self->buffer) * base->capacity);
+	while (r < 0 && errno == EINTR);
+
+	if (r < 0)
+	{
+		if (errno == EAGAIN)
+			return 0;
+		perror("can't read input device");
+		return -1;
+	}
+
+	*events = self->buffer;
+	return r / sizeof(*self->buffer);
+}
+
+static void evdev_event_source_destroy(struct event_source *base)
+{
+	assert(base != NULL);
+	struct evdev_event_source* const self = (struct evdev_event_source*)base;
+
+	free(self->buffer);
+}
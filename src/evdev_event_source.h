@@ -0,0 +1,65 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#ifndef EVDEV_EVENT_SOURCE_H
+#define EVDEV_EVENT_SOURCE_H
+
+#include <stdbool.h>
+
+#include "event_source.h"
+#include "device_profile.h"
+
+/**
+ * \brief Event source reading an evdev device node.
+ *
+ * The buffer is as large as the one the kernel keeps for the device, so a
+ * single read() takes everything that queued up since the last wakeup.
+ * The device is not closed by the source.
+ */
+struct evdev_event_source
+{
+	struct event_source base;
+	struct input_event *buffer;
+};
+
+/**
+ * \brief Events of a single packet of a device with the capabilities in \a profile,
+ * as estimated by input_estimate_events_per_packet() in the kernel.
+ */
+int evdev_events_per_packet(const struct device_profile *profile);
+
+/**
+ * \brief Number of events the kernel buffers for a device with the capabilities in \a profile.
+ */
+int evdev_buffer_size(const struct device_profile *profile);
+
+/**
+ * \brief Create a source reading the (non-blocking) evdev \a fd described by \a profile.
+ */
+bool evdev_event_source_create(struct evdev_event_source *self, int fd, const struct device_profile *profile);
+
+#endif // EVDEV_EVENT_SOURCE_H
@@ -0,0 +1,51 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#ifndef EVENT_SOURCE_H
+#define EVENT_SOURCE_H
+
+#include <linux/input.h>
+
+/**
+ * \brief Where the translator gets raw events of an input from.
+ *
+ * \a read returns the number of events available in the source's own
+ * buffer through \a events, 0 if there are none at the moment and -1 on
+ * error. The events stay valid until the next call. A source that returns
+ * fewer than \a capacity events has nothing more to offer until \a fd
+ * polls readable again.
+ */
+struct event_source
+{
+	int (*read)(struct event_source *self, const struct input_event **events);
+	void (*destroy)(struct event_source *self);
+
+	int fd;
+	int capacity;
+};
+
+#endif // EVENT_SOURCE_H
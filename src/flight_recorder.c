@@ -0,0 +1,394 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <assert.h>
+
+#include "flight_recorder.h"
+
+static const char FLIGHT_RECORDER_MAGIC[8] = "MTTFR\0\0\0";
+static const uint32_t FLIGHT_RECORDER_VERSION = 1;
+
+// the rings never get smaller than this
+static const uint64_t FLIGHT_RECORDER_MIN_EVENTS_PER_SECOND = 8192;
+
+static const int64_t FLIGHT_RECORDER_ANOMALY_INTERVAL_US = 10000000;
+
+struct flight_recorder_file_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t input_count;
+	uint64_t input_record_count;
+	uint64_t output_record_count;
+};
+
+static int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t event_time_us(const struct input_event *ev)
+{
+	return (int64_t)ev->time.tv_sec * 1000000 + ev->time.tv_usec;
+}
+
+static bool ring_create(struct flight_recorder_ring *ring, uint64_t min_size)
+{
+	uint64_t size = 1;
+	while (size < min_size)
+		size <<= 1;
+
+	ring->records = (struct flight_recorder_record*)calloc(size, sizeof(*ring->records));
+	ring->mask = size - 1;
+	ring->head = 0;
+	return ring->records != NULL;
+}
+
+static void *flight_recorder_writer(void *arg);
+
+bool flight_recorder_create(struct flight_recorder *self, const char *path, int seconds, int events_per_second)
+{
+	assert(self != NULL);
+	assert(path != NULL);
+	self->input.records = NULL;
+	self->output.records = NULL;
+	self->dump_input.records = NULL;
+	self->dump_output.records = NULL;
+	self->path = NULL;
+	self->writer_started = false;
+	self->dump_pending = false;
+	self->quit = false;
+	self->window_us = (int64_t)seconds * 1000000;
+	self->dump_count = 0;
+	self->last_anomaly_dump_us = 0;
+	self->input_count = 0;
+
+	if (seconds <= 0)
+	{
+		fprintf(stderr, "flight_recorder_create: invalid length of the recording\n");
+		return false;
+	}
+
+	uint64_t rate = events_per_second > 0 ? (uint64_t)events_per_second : 0;
+	if (rate < FLIGHT_RECORDER_MIN_EVENTS_PER_SECOND)
+		rate = FLIGHT_RECORDER_MIN_EVENTS_PER_SECOND;
+	const uint64_t size = (uint64_t)seconds * rate;
+	self->path = strdup(path);
+	if (!self->path || !ring_create(&self->input, size) || !ring_create(&self->output, size)
+		|| !ring_create(&self->dump_input, size) || !ring_create(&self->dump_output, size))
+	{
+		fprintf(stderr, "flight_recorder_create: can't allocate the recording buffers\n");
+		flight_recorder_destroy(self);
+		return false;
+	}
+
+	pthread_mutex_init(&self->lock, NULL);
+	pthread_cond_init(&self->wake, NULL);
+
+	// signals are for the translator thread
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	const int r = pthread_create(&self->writer, NULL, flight_recorder_writer, self);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (r != 0)
+	{
+		fprintf(stderr, "flight_recorder_create: can't start the writer thread: %s\n", strerror(r));
+		pthread_cond_destroy(&self->wake);
+		pthread_mutex_destroy(&self->lock);
+		flight_recorder_destroy(self);
+		return false;
+	}
+	self->writer_started = true;
+
+	return true;
+}
+
+bool flight_recorder_add_input(struct flight_recorder *self, uint64_t abs_bits, const struct input_absinfo *absinfo,
+		int offset_x, int offset_y)
+{
+	assert(self != NULL);
+	assert(absinfo != NULL);
+	if (self->input_count == FLIGHT_RECORDER_MAX_INPUTS)
+		return false;
+
+	struct flight_recorder_input *input = &self->inputs[self->input_count++];
+	memset(input, 0, sizeof(*input));
+	input->abs_bits = abs_bits;
+	input->offset_x = offset_x;
+	input->offset_y = offset_y;
+	memcpy(input->absinfo, absinfo, sizeof(input->absinfo));
+	return true;
+}
+
+/**
+ * Index of the oldest record of the ring that is not older than \a since_us.
+ */
+static uint64_t ring_window_start(const struct flight_recorder_ring *ring, int64_t since_us)
+{
+	const uint64_t size = ring->mask + 1;
+	uint64_t start = ring->head > size ? ring->head - size : 0;
+	while (start < ring->head && event_time_us(&ring->records[start & ring->mask].event) < since_us)
+		++start;
+	return start;
+}
+
+static bool ring_write(const struct flight_recorder_ring *ring, uint64_t start, FILE *f)
+{
+	for (uint64_t i = start; i < ring->head; )
+	{
+		// up to the end of the buffer at once
+		const uint64_t first = i & ring->mask;
+		uint64_t count = ring->mask + 1 - first;
+		if (count > ring->head - i)
+			count = ring->head - i;
+
+		if (fwrite(&ring->records[first], sizeof(*ring->records), count, f) != count)
+			return false;
+		i += count;
+	}
+	return true;
+}
+
+static bool write_dump(struct flight_recorder *self)
+{
+	struct flight_recorder_file_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic));
+	header.version = FLIGHT_RECORDER_VERSION;
+	header.input_count = self->input_count;
+	header.input_record_count = self->dump_input.head - self->dump_input_start;
+	header.output_record_count = self->dump_output.head - self->dump_output_start;
+
+	FILE *f = fopen(self->dump_name, "wb");
+	if (!f)
+	{
+		perror("flight_recorder_dump: can't create dump file");
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(self->inputs, sizeof(self->inputs[0]), self->input_count, f) == self->input_count
+		&& ring_write(&self->dump_input, self->dump_input_start, f)
+		&& ring_write(&self->dump_output, self->dump_output_start, f);
+	if (fclose(f) != 0)
+		ok = false;
+
+	// less than the window when the rings overflowed or a previous dump took the older events
+	int64_t span_us = 0;
+	if (header.input_record_count > 0)
+	{
+		const struct flight_recorder_ring *ring = &self->dump_input;
+		span_us = event_time_us(&ring->records[(ring->head - 1) & ring->mask].event)
+			- event_time_us(&ring->records[self->dump_input_start & ring->mask].event);
+	}
+
+	if (ok)
+		fprintf(stderr, "flight recorder: %s, dumped %" PRIu64 " input and %" PRIu64 " output events covering %.1f s to '%s'\n",
+				self->dump_reason, header.input_record_count, header.output_record_count, span_us / 1e6, self->dump_name);
+	else
+		perror("flight_recorder_dump: can't write dump file");
+
+	return ok;
+}
+
+static void *flight_recorder_writer(void *arg)
+{
+	struct flight_recorder *self = (struct flight_recorder*)arg;
+
+	pthread_mutex_lock(&self->lock);
+	while (true)
+	{
+		while (!self->dump_pending && !self->quit)
+			pthread_cond_wait(&self->wake, &self->lock);
+
+		// a dump requested right before quitting is still written
+		if (!self->dump_pending)
+			break;
+
+		pthread_mutex_unlock(&self->lock);
+		write_dump(self);
+		pthread_mutex_lock(&self->lock);
+
+		self->dump_pending = false;
+	}
+	pthread_mutex_unlock(&self->lock);
+
+	return NULL;
+}
+
+bool flight_recorder_dump(struct flight_recorder *self, const char *reason)
+{
+	assert(self != NULL);
+
+	pthread_mutex_lock(&self->lock);
+	const bool busy = self->dump_pending;
+	pthread_mutex_unlock(&self->lock);
+	if (busy)
+	{
+		fprintf(stderr, "flight recorder: %s, previous dump still being written\n", reason);
+		return false;
+	}
+
+	// the window ends with the newest input event
+	int64_t since_us = INT64_MIN;
+	if (self->input.head > 0)
+		since_us = event_time_us(&self->input.records[(self->input.head - 1) & self->input.mask].event) - self->window_us;
+
+	// the writer thread is idle, swap the full rings for the spare ones
+	struct flight_recorder_ring ring = self->dump_input;
+	self->dump_input = self->input;
+	self->input = ring;
+	self->input.head = 0;
+
+	ring = self->dump_output;
+	self->dump_output = self->output;
+	self->output = ring;
+	self->output.head = 0;
+
+	self->dump_input_start = ring_window_start(&self->dump_input, since_us);
+	self->dump_output_start = ring_window_start(&self->dump_output, since_us);
+	snprintf(self->dump_name, sizeof(self->dump_name), "%s.%u", self->path, self->dump_count++);
+	snprintf(self->dump_reason, sizeof(self->dump_reason), "%s", reason);
+
+	pthread_mutex_lock(&self->lock);
+	self->dump_pending = true;
+	pthread_cond_signal(&self->wake);
+	pthread_mutex_unlock(&self->lock);
+
+	return true;
+}
+
+bool flight_recorder_anomaly(struct flight_recorder *self, const char *reason)
+{
+	assert(self != NULL);
+	const int64_t now = monotonic_us();
+	if (self->last_anomaly_dump_us != 0 && now - self->last_anomaly_dump_us < FLIGHT_RECORDER_ANOMALY_INTERVAL_US)
+		return true;
+
+	self->last_anomaly_dump_us = now;
+	return flight_recorder_dump(self, reason);
+}
+
+void flight_recorder_destroy(struct flight_recorder *self)
+{
+	assert(self != NULL);
+	if (self->writer_started)
+	{
+		pthread_mutex_lock(&self->lock);
+		self->quit = true;
+		pthread_cond_signal(&self->wake);
+		pthread_mutex_unlock(&self->lock);
+
+		pthread_join(self->writer, NULL);
+		pthread_cond_destroy(&self->wake);
+		pthread_mutex_destroy(&self->lock);
+		self->writer_started = false;
+	}
+
+	free(self->input.records);
+	free(self->output.records);
+	free(self->dump_input.records);
+	free(self->dump_output.records);
+	free(self->path);
+	self->input.records = NULL;
+	self->output.records = NULL;
+	self->dump_input.records = NULL;
+	self->dump_output.records = NULL;
+	self->path = NULL;
+}
+
+bool flight_recorder_replay_open(struct flight_recorder_replay *self, const char *path)
+{
+	assert(self != NULL);
+	self->file = fopen(path, "rb");
+	if (!self->file)
+	{
+		perror("can't open recording");
+		return false;
+	}
+
+	struct flight_recorder_file_header header;
+	if (fread(&header, sizeof(header), 1, self->file) != 1
+		|| memcmp(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != FLIGHT_RECORDER_VERSION
+		|| header.input_count == 0 || header.input_count > FLIGHT_RECORDER_MAX_INPUTS)
+	{
+		fprintf(stderr, "'%s' is not a flight recorder dump\n", path);
+		fclose(self->file);
+		self->file = NULL;
+		return false;
+	}
+
+	self->input_count = header.input_count;
+	self->remaining = header.input_record_count;
+	if (fread(self->inputs, sizeof(self->inputs[0]), self->input_count, self->file) != self->input_count)
+	{
+		fprintf(stderr, "'%s' is truncated\n", path);
+		fclose(self->file);
+		self->file = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+int flight_recorder_replay_read(struct flight_recorder_replay *self, struct flight_recorder_record *records, int max)
+{
+	assert(self != NULL);
+	assert(max > 0);
+	const size_t count = self->remaining < (uint64_t)max ? (size_t)self->remaining : (size_t)max;
+	if (count == 0)
+		return 0;
+
+	if (fread(records, sizeof(*records), count, self->file) != count)
+	{
+		fprintf(stderr, "flight_recorder_replay_read: recording is truncated\n");
+		return -1;
+	}
+
+	self->remaining -= count;
+	return (int)count;
+}
+
+void flight_recorder_replay_close(struct flight_recorder_replay *self)
+{
+	assert(self != NULL);
+	if (self->file)
+		fclose(self->file);
+	self->file = NULL;
+}
@@ -0,0 +1,171 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <linux/input.h>
+
+#define FLIGHT_RECORDER_MAX_INPUTS 8
+
+struct flight_recorder_record
+{
+	uint32_t input;
+	uint32_t reserved;
+	struct input_event event;
+};
+
+struct flight_recorder_ring
+{
+	struct flight_recorder_record *records;
+	uint64_t mask;
+	uint64_t head; // number of records ever written
+};
+
+/**
+ * \brief What is needed to translate the recorded input again.
+ */
+struct flight_recorder_input
+{
+	uint64_t abs_bits;
+	int32_t offset_x, offset_y;
+	struct input_absinfo absinfo[ABS_CNT];
+};
+
+/**
+ * \brief Keeps the last seconds of raw input and translated output in memory.
+ *
+ * The output is recorded by a recording_event_dispatcher in front of the output device.
+ *
+ * Recording is a copy into a preallocated ring. The rings are written to
+ * "<path>.<n>" on request or when an anomaly is reported; automatic dumps
+ * are rate limited. A dump swaps the rings for a spare pair and leaves the
+ * full ones to a writer thread, so the translator is not held up by disk
+ * I/O; recording carries on into the empty rings. A dump shortly after
+ * another one (say a SIGUSR1 right after an anomaly) therefore only holds
+ * what was recorded since, the dump message tells the time it covers. The file holds a header, the flight_recorder_input of
+ * every input and the input and output records, all in host byte order,
+ * and can be replayed with flight_recorder_replay_open().
+ */
+struct flight_recorder
+{
+	struct flight_recorder_ring input, output;
+	char *path;
+	int64_t window_us;
+	unsigned dump_count;
+	int64_t last_anomaly_dump_us;
+
+	uint32_t input_count;
+	struct flight_recorder_input inputs[FLIGHT_RECORDER_MAX_INPUTS];
+
+	// the rings being written by the writer thread
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	bool writer_started;
+	bool dump_pending; // the rings are handed over and not written yet
+	bool quit;
+	struct flight_recorder_ring dump_input, dump_output; // the spare pair while no dump is pending
+	uint64_t dump_input_start, dump_output_start;
+	char dump_name[256];
+	char dump_reason[64];
+};
+
+/**
+ * \brief Keep the last \a seconds of up to \a events_per_second input events, and as many output events.
+ */
+bool flight_recorder_create(struct flight_recorder *self, const char *path, int seconds, int events_per_second);
+
+bool flight_recorder_add_input(struct flight_recorder *self, uint64_t abs_bits, const struct input_absinfo *absinfo,
+		int offset_x, int offset_y);
+
+static inline void flight_recorder_record(struct flight_recorder_ring *ring, uint32_t input,
+		const struct input_event *events, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		struct flight_recorder_record *r = &ring->records[ring->head++ & ring->mask];
+		r->input = input;
+		r->event = events[i];
+	}
+}
+
+static inline void flight_recorder_record_input(struct flight_recorder *self, uint32_t input,
+		const struct input_event *events, int count)
+{
+	flight_recorder_record(&self->input, input, events, count);
+}
+
+static inline void flight_recorder_record_output(struct flight_recorder *self, uint32_t input,
+		const struct input_event *events, int count)
+{
+	flight_recorder_record(&self->output, input, events, count);
+}
+
+/**
+ * \brief Write the recorded window to the next dump file.
+ *
+ * The file is written in the background; fails if the previous dump is still being written.
+ */
+bool flight_recorder_dump(struct flight_recorder *self, const char *reason);
+
+/**
+ * \brief Report an anomaly; dumps unless another anomaly was dumped recently.
+ */
+bool flight_recorder_anomaly(struct flight_recorder *self, const char *reason);
+
+void flight_recorder_destroy(struct flight_recorder *self);
+
+struct flight_recorder_replay
+{
+	FILE *file;
+	uint64_t remaining; // input records not read yet
+
+	uint32_t input_count;
+	struct flight_recorder_input inputs[FLIGHT_RECORDER_MAX_INPUTS];
+};
+
+/**
+ * \brief Open a dump written by flight_recorder_dump() for replaying its input.
+ */
+bool flight_recorder_replay_open(struct flight_recorder_replay *self, const char *path);
+
+/**
+ * \brief Read the next recorded input records.
+ *
+ * \return number of records read, 0 at the end or -1 on error
+ */
+int flight_recorder_replay_read(struct flight_recorder_replay *self, struct flight_recorder_record *records, int max);
+
+void flight_recorder_replay_close(struct flight_recorder_replay *self);
+
+#endif // FLIGHT_RECORDER_H
@@ -32,10 +32,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <linux/input.h>
 
 #include "input_utils.h"
+#include "metrics.h"
 
 static bool get_bit(uint8_t const* bits, size_t size, size_t bitIndex)
 {
@@ -67,6 +69,29 @@ bool foreach_capability(int fd, FOREACH_CAPABILITY_CB cb, void *user_data)
 	}
 }
 
+bool foreach_code(int fd, uint32_t type, uint32_t max_code, FOREACH_CAPABILITY_CB cb, void *user_data)
+{
+	// KEY_MAX is the largest of the *_MAX constants
+	uint8_t bits[KEY_MAX/8 + 1];
+	assert(max_code <= KEY_MAX);
+	memset(bits, 0, sizeof(bits));
+	if (ioctl(fd, EVIOCGBIT(type, sizeof(bits)), bits) < 0)
+	{
+		perror("can't get device code bits");
+		return false;
+	}
+
+	for (uint32_t idx = 0; idx <= max_code; ++idx)
+	{
+		if (get_bit(bits, sizeof(bits)/sizeof(bits[0]), idx))
+		{
+			if (!cb(fd, idx, user_data))
+				break;
+		}
+	}
+	return true;
+}
+
 typedef struct
 {
 	bool first;
@@ -177,3 +202,64 @@ bool print_input_device_info(int fd)
 
 	return true;
 }
+
+bool get_absinfo(int fd, uint32_t code, struct input_absinfo *absinfo)
+{
+	assert(absinfo != NULL);
+	memset(absinfo, 0, sizeof(*absinfo));
+	if (ioctl(fd, EVIOCGABS(code), absinfo) < 0)
+	{
+		perror("can't get axis range");
+		return false;
+	}
+	return true;
+}
+
+static bool get_absinfo_cb(int fd, uint32_t code, void *user_data)
+{
+	struct input_absinfo *absinfo = (struct input_absinfo*)user_data;
+	return get_absinfo(fd, code, &absinfo[code]);
+}
+
+bool get_absinfo_table(int fd, struct input_absinfo *absinfo)
+{
+	assert(absinfo != NULL);
+	memset(absinfo, 0, sizeof(*absinfo) * ABS_CNT);
+	return foreach_code(fd, EV_ABS, ABS_MAX, get_absinfo_cb, absinfo);
+}
+
+static bool set_abs_bit_cb(int fd, uint32_t code, void *user_data)
+{
+	(void)fd; // unused
+	*(uint64_t*)user_data |= (uint64_t)1 << code;
+	return true;
+}
+
+bool get_abs_bits(int fd, uint64_t *abs_bits)
+{
+	assert(abs_bits != NULL);
+	*abs_bits = 0;
+	return foreach_code(fd, EV_ABS, ABS_MAX, set_abs_bit_cb, abs_bits);
+}
+
+bool write_events(int fd, const struct input_event *events, int count, struct metrics_output *metrics,
+		const volatile sig_atomic_t *cancel)
+{
+	const char *data = (const char*)events;
+	size_t left = sizeof(*events)*count;
+	while (left > 0)
+	{
+		const ssize_t written = write(fd, data, left);
+		if (written < 0 && errno == EINTR && !(cancel && *cancel))
+			continue;
+
+		if (metrics)
+			metrics_count_write(metrics, written, left);
+		if (written <= 0)
+			return false;
+
+		data += written;
+		left -= written;
+	}
+	return true;
+}
@@ -30,14 +30,51 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <signal.h>
+#include <linux/input.h>
+
+struct metrics_output;
 
 typedef bool (*FOREACH_CAPABILITY_CB)(int fd, uint32_t capability, void *user_data);
 
 bool foreach_capability(int fd, FOREACH_CAPABILITY_CB cb, void *user_data);
 
+/**
+ * \brief Call \a cb for every code (key, axis, ...) of event type \a type that the device supports.
+ */
+bool foreach_code(int fd, uint32_t type, uint32_t max_code, FOREACH_CAPABILITY_CB cb, void *user_data);
+
 /**
  * \brief Do a bunch of IOCTLs querying the device and print the results.
  */
 bool print_input_device_info(int fd);
 
+/**
+ * \brief Query the range of the absolute axis \a code.
+ */
+bool get_absinfo(int fd, uint32_t code, struct input_absinfo *absinfo);
+
+/**
+ * \brief Fill a table of ABS_CNT items with the ranges of all axes of the device.
+ *
+ * Items of unsupported axes are zeroed.
+ */
+bool get_absinfo_table(int fd, struct input_absinfo *absinfo);
+
+/**
+ * \brief Get a mask with bit N set if the device has axis N.
+ */
+bool get_abs_bits(int fd, uint64_t *abs_bits);
+
+/**
+ * \brief Write all of \a events to \a fd, carrying on after interrupted and partial writes.
+ *
+ * A partial write would leave the consumer with a torn event. The writes
+ * are accounted to \a metrics unless it is NULL. An interrupted write gives
+ * up once \a cancel (may be NULL) is set, so that a stalled consumer can't
+ * keep the translator from quitting.
+ */
+bool write_events(int fd, const struct input_event *events, int count, struct metrics_output *metrics,
+		const volatile sig_atomic_t *cancel);
+
 #endif // INPUT_UTILS_H
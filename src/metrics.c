@@ -0,0 +1,316 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <linux/input.h>
+#include <assert.h>
+
+#include "metrics.h"
+
+// a client that does not take the response within this time is dropped
+static const int METRICS_SEND_TIMEOUT_S = 1;
+
+struct metrics_buffer
+{
+	char data[8192];
+	size_t length;
+};
+
+static void append(struct metrics_buffer *b, const char *format, ...)
+{
+	if (b->length >= sizeof(b->data))
+		return;
+
+	va_list ap;
+	va_start(ap, format);
+	const int r = vsnprintf(b->data + b->length, sizeof(b->data) - b->length, format, ap);
+	va_end(ap);
+
+	if (r > 0)
+		b->length += r;
+	if (b->length > sizeof(b->data))
+		b->length = sizeof(b->data);
+}
+
+static uint64_t load(const uint64_t *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void append_header(struct metrics_buffer *b, const char *name, const char *type, const char *help)
+{
+	append(b, "# HELP mt_translator_%s %s\n# TYPE mt_translator_%s %s\n", name, help, name, type);
+}
+
+static void append_input_counter(struct metrics_buffer *b, const struct metrics *self, const char *name,
+		const char *help, size_t offset)
+{
+	append_header(b, name, "counter", help);
+	for (int k = 0; k < self->input_count; ++k)
+	{
+		const uint64_t *counter = (const uint64_t*)((const char*)&self->inputs[k] + offset);
+		append(b, "mt_translator_%s{input=\"%d\"} %llu\n", name, k, (unsigned long long)load(counter));
+	}
+}
+
+static void append_gauge(struct metrics_buffer *b, const char *name, const char *help, const uint64_t *gauge)
+{
+	append_header(b, name, "gauge", help);
+	append(b, "mt_translator_%s %llu\n", name, (unsigned long long)load(gauge));
+}
+
+static void append_output_counter(struct metrics_buffer *b, const char *name, const char *help, const uint64_t *counter)
+{
+	append_header(b, name, "counter", help);
+	append(b, "mt_translator_%s %llu\n", name, (unsigned long long)load(counter));
+}
+
+static void render(const struct metrics *self, struct metrics_buffer *b)
+{
+	b->length = 0;
+
+	append_input_counter(b, self, "events_read_total", "Raw events read from the input device.",
+		offsetof(struct metrics_input, events_read));
+	append_input_counter(b, self, "frames_in_total", "Frames produced by mtdev.",
+		offsetof(struct metrics_input, frames_in));
+	append_input_counter(b, self, "dispatch_failures_total", "Frames the dispatcher chain failed to deliver.",
+		offsetof(struct metrics_input, dispatch_failures));
+	append_input_counter(b, self, "syn_dropped_total", "SYN_DROPPED events reported by the kernel.",
+		offsetof(struct metrics_input, syn_dropped));
+
+	append_output_counter(b, "frames_out_total", "Frames accepted by the output.", &self->output.frames_out);
+	append_output_counter(b, "bytes_written_total", "Bytes written to the output.", &self->output.bytes_written);
+	append_output_counter(b, "short_writes_total", "Writes to the output that were cut short.", &self->output.short_writes);
+	append_output_counter(b, "write_failures_total", "Writes to the output that failed.", &self->output.write_failures);
+
+	if (__atomic_load_n(&self->has_queue, __ATOMIC_RELAXED))
+	{
+		append_gauge(b, "backlog_frames", "Frames queued by the backlog for the output.", &self->queue.frames);
+		append_gauge(b, "backlog_events", "Events of the frames queued by the backlog.", &self->queue.events);
+		append_header(b, "backlog_frames_collapsed_total", "counter", "Motion-only frames merged by the priority lane.");
+		append(b, "mt_translator_backlog_frames_collapsed_total %llu\n", (unsigned long long)load(&self->queue.frames_collapsed));
+	}
+
+	const int backlog_fd = __atomic_load_n(&self->backlog_fd, __ATOMIC_RELAXED);
+	int queued;
+	if (backlog_fd >= 0 && ioctl(backlog_fd, FIONREAD, &queued) == 0)
+	{
+		append_header(b, "output_backlog_events", "gauge", "Events written to the output and not read yet.");
+		append(b, "mt_translator_output_backlog_events %d\n", queued / (int)sizeof(struct input_event));
+	}
+}
+
+static void serve_client(const struct metrics *self, int fd)
+{
+	const struct timeval timeout = { METRICS_SEND_TIMEOUT_S, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	static struct metrics_buffer buffer;
+	render(self, &buffer);
+
+	size_t sent = 0;
+	while (sent < buffer.length)
+	{
+		const ssize_t r = send(fd, buffer.data + sent, buffer.length - sent, MSG_NOSIGNAL);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		sent += r;
+	}
+}
+
+static void *metrics_thread(void *arg)
+{
+	struct metrics *self = (struct metrics*)arg;
+
+	struct pollfd fds[2];
+	fds[0].fd = self->listen_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = self->wake_fds[0];
+	fds[1].events = POLLIN;
+
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("metrics: poll failed");
+			break;
+		}
+
+		if (fds[1].revents)
+			break;
+
+		if (fds[0].revents & POLLIN)
+		{
+			const int fd = accept(self->listen_fd, NULL, NULL);
+			if (fd >= 0)
+			{
+				serve_client(self, fd);
+				close(fd);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static bool open_socket(struct metrics *self, const char *socket_path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "metrics: socket path too long\n");
+		return false;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	self->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (self->listen_fd < 0)
+	{
+		perror("metrics: can't create socket");
+		return false;
+	}
+
+	// a socket left behind by a previous run, anything else is not ours to remove
+	struct stat st;
+	if (lstat(socket_path, &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			fprintf(stderr, "metrics: %s exists and is not a socket\n", socket_path);
+			close(self->listen_fd);
+			return false;
+		}
+		unlink(socket_path);
+	}
+
+	if (bind(self->listen_fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(self->listen_fd, 4) != 0)
+	{
+		perror("metrics: can't listen on socket");
+		close(self->listen_fd);
+		return false;
+	}
+
+	return true;
+}
+
+bool metrics_create(struct metrics *self, const char *socket_path, int input_count)
+{
+	assert(self != NULL);
+	assert(socket_path != NULL);
+	assert(input_count > 0 && input_count <= METRICS_MAX_INPUTS);
+
+	memset(self->inputs, 0, sizeof(self->inputs));
+	memset(&self->output, 0, sizeof(self->output));
+	memset(&self->queue, 0, sizeof(self->queue));
+	self->has_queue = false;
+	self->input_count = input_count;
+	self->backlog_fd = -1;
+
+	if (!open_socket(self, socket_path))
+		return false;
+
+	self->socket_path = strdup(socket_path);
+	if (pipe(self->wake_fds) != 0)
+	{
+		perror("metrics: can't create pipe");
+		close(self->listen_fd);
+		unlink(socket_path);
+		free(self->socket_path);
+		return false;
+	}
+
+	// signals are for the translator thread, its poll() has to see them
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	const int r = pthread_create(&self->thread, NULL, metrics_thread, self);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (r != 0)
+	{
+		fprintf(stderr, "metrics: can't start thread: %s\n", strerror(r));
+		close(self->wake_fds[0]);
+		close(self->wake_fds[1]);
+		close(self->listen_fd);
+		unlink(socket_path);
+		free(self->socket_path);
+		return false;
+	}
+
+	return true;
+}
+
+void metrics_set_backlog_fd(struct metrics *self, int fd)
+{
+	assert(self != NULL);
+	__atomic_store_n(&self->backlog_fd, fd, __ATOMIC_RELAXED);
+}
+
+struct metrics_queue *metrics_use_queue(struct metrics *self)
+{
+	assert(self != NULL);
+	__atomic_store_n(&self->has_queue, true, __ATOMIC_RELAXED);
+	return &self->queue;
+}
+
+void metrics_destroy(struct metrics *self)
+{
+	assert(self != NULL);
+
+	const char quit = 0;
+	if (write(self->wake_fds[1], &quit, 1) != 1)
+		perror("metrics: can't stop thread");
+	pthread_join(self->thread, NULL);
+
+	close(self->wake_fds[0]);
+	close(self->wake_fds[1]);
+	close(self->listen_fd);
+	unlink(self->socket_path);
+	free(self->socket_path);
+}
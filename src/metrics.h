@@ -0,0 +1,154 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define METRICS_MAX_INPUTS 8
+
+// keeps counters updated by the translator off the cache lines the server reads elsewhere
+#define METRICS_CACHE_LINE 64
+
+/**
+ * \brief Counters of a single input device.
+ */
+struct metrics_input
+{
+	uint64_t events_read; // raw events read from the device
+	uint64_t frames_in; // frames produced by mtdev
+	uint64_t dispatch_failures;
+	uint64_t syn_dropped;
+} __attribute__((aligned(METRICS_CACHE_LINE)));
+
+/**
+ * \brief Counters of the output dispatcher.
+ */
+struct metrics_output
+{
+	uint64_t frames_out; // frames the output accepted
+	uint64_t bytes_written;
+	uint64_t short_writes;
+	uint64_t write_failures;
+} __attribute__((aligned(METRICS_CACHE_LINE)));
+
+/**
+ * \brief State of the queue of the backlog stage.
+ */
+struct metrics_queue
+{
+	uint64_t frames; // gauge, frames waiting for the output
+	uint64_t events; // gauge, events of those frames
+	uint64_t frames_collapsed; // motion-only frames merged by the priority lane
+} __attribute__((aligned(METRICS_CACHE_LINE)));
+
+/**
+ * \brief Counters exported in the Prometheus text format over a Unix socket.
+ *
+ * The counters have a single writer, the translator thread, which bumps
+ * them with metrics_add. A separate thread accepts connections, writes a
+ * snapshot taken with relaxed atomic loads and closes the connection, so
+ * a slow or stuck client never holds up the translator.
+ */
+struct metrics
+{
+	int input_count;
+	struct metrics_input inputs[METRICS_MAX_INPUTS];
+	struct metrics_output output;
+	struct metrics_queue queue;
+	bool has_queue; // a backlog stage feeds \a queue
+
+	int backlog_fd; // output whose queued bytes are reported, -1 if unknown
+
+	char *socket_path;
+	int listen_fd;
+	int wake_fds[2]; // tells the server thread to quit
+	pthread_t thread;
+};
+
+/**
+ * \brief Add \a value to a counter.
+ *
+ * Only the translator thread writes the counters, so a relaxed load and
+ * store suffice and no locked read-modify-write is needed.
+ */
+static inline void metrics_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Set a gauge to \a value.
+ */
+static inline void metrics_set(uint64_t *gauge, uint64_t value)
+{
+	__atomic_store_n(gauge, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Account a write() of \a expected bytes to an output that returned \a written.
+ */
+static inline void metrics_count_write(struct metrics_output *output, ssize_t written, size_t expected)
+{
+	if (written < 0)
+	{
+		metrics_add(&output->write_failures, 1);
+		return;
+	}
+
+	metrics_add(&output->bytes_written, written);
+	if ((size_t)written == expected)
+		metrics_add(&output->frames_out, 1);
+	else
+		metrics_add(&output->short_writes, 1);
+}
+
+/**
+ * \brief Create the counters for \a input_count inputs and start serving them on \a socket_path.
+ */
+bool metrics_create(struct metrics *self, const char *socket_path, int input_count);
+
+/**
+ * \brief Report the number of events queued in the fifo \a fd as the output backlog.
+ */
+void metrics_set_backlog_fd(struct metrics *self, int fd);
+
+/**
+ * \brief Export \a queue, the returned queue metrics are to be fed by the backlog stage.
+ */
+struct metrics_queue *metrics_use_queue(struct metrics *self);
+
+/**
+ * \brief Stop the server thread and remove the socket.
+ */
+void metrics_destroy(struct metrics *self);
+
+#endif // METRICS_H
@@ -36,56 +36,439 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 
 #include <linux/input.h>
-#include <mtdev.h>
+#include <mtdev-plumbing.h>
 
 #include <assert.h>
 
+#include "config.h"
+
 #ifdef HAVE_LINUX_UINPUT_H
 	#include <linux/uinput.h>
 #endif
 
-#include "config.h"
-
 #include "mt-translator.h"
 #include "event_dispatcher.h"
+#include "evdev_event_source.h"
 #include "pipe_event_dispatcher.h"
 #ifdef HAVE_LINUX_UINPUT_H
 	#include "uinput_event_dispatcher.h"
 #endif
+#include "prediction_event_dispatcher.h"
+#include "transform_event_dispatcher.h"
+#include "deadband_event_dispatcher.h"
+#include "backlog_event_dispatcher.h"
+#include "panel_merger.h"
+#include "flight_recorder.h"
+#include "recording_event_dispatcher.h"
+#include "mtdev_utils.h"
+#include "profiler.h"
+#include "trace.h"
+#include "device_profile.h"
+#include "metrics.h"
 #include "input_utils.h"
 
 static const unsigned MAX_EVENTS = 10;
 const char *progname;
 
-int translate_loop(int fd, struct event_dispatcher *ed)
+#define MAX_INPUTS PANEL_MERGER_MAX_PANELS
+#define MAX_FRAME_EVENTS 256
+#define MAX_TRACED_SLOTS PANEL_MERGER_MAX_SLOTS
+
+// dispatching a frame for longer than this is an anomaly
+static const int64_t STALL_US = 100000;
+
+// report rate the flight recorder is sized for; contacts rarely change all
+// their axes at once, so a report is taken to be half a full packet
+static const int RECORD_PACKET_RATE = 1000;
+
+struct translator_input
 {
+	int fd;
+	struct event_source *source; // NULL when replaying
+	struct event_dispatcher *ed;
 	struct mtdev mtd;
-	if (mtdev_open(&mtd, fd) == 0)
+
+	uint64_t reads; // that returned events
+	uint64_t frames;
+
+	int frame_count;
+	struct input_event frame[MAX_FRAME_EVENTS];
+
+	// for tracing
+	uint64_t frame_begin_ns;
+	int slot;
+	uint64_t active_slots[MAX_TRACED_SLOTS / 64];
+};
+
+struct translator
+{
+	int input_count;
+	struct translator_input inputs[MAX_INPUTS];
+
+	struct flight_recorder *recorder;
+	struct profiler *profiler;
+	struct trace_writer *tracer;
+	struct metrics *metrics;
+	struct backlog_event_dispatcher *backlog;
+
+	bool verbose;
+	int64_t open_us; // when the first input was opened
+	int64_t output_wait_us; // spent waiting for a reader of the output fifo
+};
+
+static volatile sig_atomic_t dump_requested = 0;
+static volatile sig_atomic_t profile_requested = 0;
+static volatile sig_atomic_t quit_requested = 0;
+
+static void request_dump(int signum)
+{
+	(void)signum; // unused
+	dump_requested = 1;
+}
+
+static void request_profile(int signum)
+{
+	(void)signum; // unused
+	profile_requested = 1;
+}
+
+static void request_quit(int signum)
+{
+	(void)signum; // unused
+	quit_requested = 1;
+}
+
+static void install_signal_handler(int signum, void (*handler)(int), int flags)
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handler;
+	sa.sa_flags = flags;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(signum, &sa, NULL) != 0)
+		perror("can't install signal handler");
+}
+
+static int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Follow the slots of the frame, returns the number of contacts. Only done
+ * while traced, so contacts that started before a tracer attached to
+ * frame_end are missed until they lift.
+ */
+static int count_contacts(struct translator_input *in)
+{
+	for (int i = 0; i < in->frame_count; ++i)
+	{
+		const struct input_event *ev = &in->frame[i];
+		if (ev->type != EV_ABS)
+			continue;
+
+		if (ev->code == ABS_MT_SLOT)
+			in->slot = ev->value;
+		else if (ev->code == ABS_MT_TRACKING_ID && in->slot >= 0 && in->slot < MAX_TRACED_SLOTS)
+		{
+			uint64_t *word = &in->active_slots[in->slot / 64];
+			const uint64_t bit = (uint64_t)1 << (in->slot % 64);
+			if (ev->value >= 0)
+				*word |= bit;
+			else
+				*word &= ~bit;
+		}
+	}
+
+	int contacts = 0;
+	for (int i = 0; i < MAX_TRACED_SLOTS / 64; ++i)
+		contacts += __builtin_popcountll(in->active_slots[i]);
+	return contacts;
+}
+
+static bool dispatch_frame(struct translator *t, int index)
+{
+	struct translator_input *in = &t->inputs[index];
+	if (in->frame_count == 0)
+		return true;
+
+	const int count = in->frame_count;
+	TRACE_PROBE2(dispatch_begin, index, count);
+	const uint64_t dispatch_begin_ns = t->tracer ? trace_writer_now_ns() : 0;
+
+	if (t->profiler)
+	{
+		profiler_enter(t->profiler, PROFILER_STAGE_DISPATCH);
+		profiler_count_frame(t->profiler);
+	}
+
+	++in->frames;
+	if (t->metrics)
+		metrics_add(&t->metrics->inputs[index].frames_in, 1);
+
+	bool ok;
+	if (t->recorder)
+	{
+		const int64_t start = monotonic_us();
+		ok = in->ed->dispatch(in->ed, in->frame, in->frame_count);
+		if (!ok)
+			flight_recorder_anomaly(t->recorder, "dispatch failed");
+		else if (monotonic_us() - start > STALL_US)
+			flight_recorder_anomaly(t->recorder, "dispatch stalled");
+	}
+	else
+		ok = in->ed->dispatch(in->ed, in->frame, in->frame_count);
+
+	TRACE_PROBE2(dispatch_end, index, ok);
+	const int contacts = (t->tracer || TRACE_PROBE_ENABLED(frame_end)) ? count_contacts(in) : 0;
+	if (t->tracer)
+	{
+		const uint64_t end_ns = trace_writer_now_ns();
+		trace_writer_stage(t->tracer, "dispatch", index, dispatch_begin_ns, end_ns);
+		trace_writer_frame(t->tracer, index, in->frame_begin_ns, end_ns, count, contacts);
+	}
+	TRACE_PROBE2(frame_end, index, contacts);
+
+	if (t->profiler)
+		profiler_enter(t->profiler, PROFILER_STAGE_MTDEV);
+
+	in->frame_count = 0;
+	if (!ok && t->metrics)
+		metrics_add(&t->metrics->inputs[index].dispatch_failures, 1);
+	if (!ok)
+		fprintf(stderr, "dispatch_events failed!\n");
+	return ok;
+}
+
+static void end_mtdev_span(struct translator *t, int index, uint64_t begin_ns)
+{
+	TRACE_PROBE1(mtdev_end, index);
+	if (t->tracer)
+		trace_writer_stage(t->tracer, "mtdev", index, begin_ns, trace_writer_now_ns());
+}
+
+/**
+ * Pass raw events of an input through mtdev and dispatch the translated frames.
+ */
+static bool translate_events(struct translator *t, int index, const struct input_event *raw, int count)
+{
+	struct translator_input *in = &t->inputs[index];
+
+	if (t->recorder)
+		flight_recorder_record_input(t->recorder, index, raw, count);
+
+	if (t->metrics)
+		metrics_add(&t->metrics->inputs[index].events_read, count);
+
+	if (t->recorder || t->metrics)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (raw[i].type != EV_SYN || raw[i].code != SYN_DROPPED)
+				continue;
+
+			if (t->recorder)
+				flight_recorder_anomaly(t->recorder, "SYN_DROPPED");
+			if (t->metrics)
+				metrics_add(&t->metrics->inputs[index].syn_dropped, 1);
+		}
+	}
+
+	TRACE_PROBE2(mtdev_begin, index, count);
+	uint64_t mtdev_begin_ns = t->tracer ? trace_writer_now_ns() : 0;
+
+	for (int i = 0; i < count; ++i)
+		mtdev_put_event(&in->mtd, &raw[i]);
+
+	// the mtdev span is closed ahead of each dispatched frame so that it does not include the pipeline
+	bool ok = true;
+	bool in_mtdev = true;
+	while (!mtdev_empty(&in->mtd))
+	{
+		if (!in_mtdev)
+		{
+			TRACE_PROBE2(mtdev_begin, index, 0);
+			if (t->tracer)
+				mtdev_begin_ns = trace_writer_now_ns();
+			in_mtdev = true;
+		}
+
+		if (in->frame_count == 0)
+		{
+			TRACE_PROBE1(frame_begin, index);
+			if (t->tracer)
+				in->frame_begin_ns = trace_writer_now_ns();
+		}
+
+		struct input_event *ev = &in->frame[in->frame_count++];
+		mtdev_get_event(&in->mtd, ev);
+
+		if ((ev->type == EV_SYN && ev->code == SYN_REPORT) || in->frame_count == MAX_FRAME_EVENTS)
+		{
+			end_mtdev_span(t, index, mtdev_begin_ns);
+			in_mtdev = false;
+			if (!dispatch_frame(t, index))
+				ok = false;
+		}
+	}
+
+	if (in_mtdev)
+		end_mtdev_span(t, index, mtdev_begin_ns);
+
+	return ok;
+}
+
+/**
+ * Startup cost, up to where the loop is about to wait for the first events.
+ */
+static void print_ready(const struct translator *t)
+{
+	if (t->verbose)
+	{
+		printf("ready %" PRId64 " us after opening the input, %" PRId64 " us of it waiting for the output reader\n",
+			monotonic_us() - t->open_us, t->output_wait_us);
+	}
+}
+
+int translate_loop(struct translator *t)
+{
+	assert(t->input_count > 0 && t->input_count <= MAX_INPUTS);
+
+	struct pollfd fds[MAX_INPUTS + 1];
+	for (int k = 0; k < t->input_count; ++k)
+	{
+		fds[k].fd = t->inputs[k].fd;
+		fds[k].events = POLLIN;
+		fds[k].revents = 0;
+	}
+
+	print_ready(t);
+
+	bool running = true;
+	while (running && !quit_requested)
 	{
-		struct input_event events[MAX_EVENTS];
-		int i = 0;
-		while (!mtdev_idle(&mtd, fd, -1))
+		if (dump_requested)
 		{
-			while (i = mtdev_get(&mtd, fd, events, sizeof(events)/sizeof(events[0])), i > 0)
+			dump_requested = 0;
+			if (t->recorder)
+				flight_recorder_dump(t->recorder, "dump requested");
+		}
+		if (profile_requested)
+		{
+			profile_requested = 0;
+			if (t->profiler)
+				profiler_print(t->profiler, stdout);
+		}
+
+		if (t->profiler)
+			profiler_enter(t->profiler, PROFILER_STAGE_POLL);
+
+		// wait for room in the output only while there is something to write
+		int nfds = t->input_count;
+		if (t->backlog && backlog_event_dispatcher_pending(t->backlog))
+		{
+			fds[nfds].fd = t->backlog->fd;
+			fds[nfds].events = POLLOUT;
+			fds[nfds].revents = 0;
+			++nfds;
+		}
+
+		const int ready = poll(fds, nfds, -1);
+
+		if (t->profiler)
+			profiler_enter(t->profiler, PROFILER_STAGE_MTDEV);
+
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("poll failed");
+			break;
+		}
+
+		if (nfds > t->input_count && fds[t->input_count].revents)
+		{
+			if (t->profiler)
+				profiler_enter(t->profiler, PROFILER_STAGE_DISPATCH);
+
+			const bool flushed = backlog_event_dispatcher_flush(t->backlog);
+
+			if (t->profiler)
+				profiler_enter(t->profiler, PROFILER_STAGE_MTDEV);
+
+			if (!flushed)
 			{
-				if (!ed->dispatch(ed, events, i))
+				fprintf(stderr, "can't write output!\n");
+				break;
+			}
+		}
+
+		for (int k = 0; k < t->input_count; ++k)
+		{
+			if (fds[k].revents & (POLLERR | POLLHUP | POLLNVAL))
+			{
+				fprintf(stderr, "input device gone!\n");
+				running = false;
+				break;
+			}
+			if (!(fds[k].revents & POLLIN))
+				continue;
+
+			// read in bulk here, mtdev_fetch_event() would read() a single event per call
+			struct event_source *source = t->inputs[k].source;
+			while (true)
+			{
+				const struct input_event *events;
+				const int n = source->read(source, &events);
+				if (n < 0)
 				{
-					fprintf(stderr, "dispatch_events failed!\n");
+					running = false;
 					break;
 				}
+				if (n == 0)
+					break;
+
+				++t->inputs[k].reads;
+				if (!translate_events(t, k, events, n))
+					break;
+
+				// a read that did not fill the buffer emptied the kernel queue
+				if (n < source->capacity)
+					break;
 			}
+			if (!running)
+				break;
 		}
-
-		mtdev_close(&mtd);
 	}
-	else
-		fprintf(stderr, "mtdev_open failed!\n");
 
 	return 0;
 }
 
+int replay_loop(struct translator *t, struct flight_recorder_replay *replay)
+{
+	struct flight_recorder_record records[MAX_EVENTS];
+	int n = 0;
+	print_ready(t);
+	while (!quit_requested && (n = flight_recorder_replay_read(replay, records, sizeof(records)/sizeof(records[0]))) > 0)
+	{
+		for (int i = 0; i < n && !quit_requested; ++i)
+		{
+			if (records[i].input < (uint32_t)t->input_count)
+				translate_events(t, records[i].input, &records[i].event, 1);
+		}
+	}
+
+	return n < 0 ? 1 : 0;
+}
+
 static const struct option long_options[] =
 {
 	{"help",			no_argument,		0,	'h'},
@@ -93,6 +476,19 @@ static const struct option long_options[] =
 	{"input",		required_argument,		0,	'i'},
 	{"pipe",		required_argument,		0,	'p'},
 	{"verbose",			no_argument,		0,	'v'},
+	{"predict",		required_argument,		0,	'P'},
+	{"calibrate",		required_argument,		0,	'c'},
+	{"swap-axes",			no_argument,		0,	's'},
+	{"offset",		required_argument,		0,	'O'},
+	{"record",		required_argument,		0,	'R'},
+	{"record-seconds",	required_argument,		0,	'S'},
+	{"replay",		required_argument,		0,	'r'},
+	{"profile",			no_argument,		0,	'f'},
+	{"trace",		required_argument,		0,	'T'},
+	{"profile-cache",	required_argument,		0,	'C'},
+	{"deadband",		required_argument,		0,	'D'},
+	{"metrics",		required_argument,		0,	'M'},
+	{"backlog",		required_argument,		0,	'B'},
 #ifdef HAVE_LINUX_UINPUT_H
 	{"uinput",			no_argument,		0,	'u'},
 #endif
@@ -100,20 +496,38 @@ static const struct option long_options[] =
 	{0, 0, 0, 0}
 };
 
-const char short_options[] = "hVi:p:v"
-#ifdef HAVE_LINUX_UINPUT
+const char short_options[] = "hVi:p:vP:c:sO:R:S:r:fT:C:D:M:B:"
+#ifdef HAVE_LINUX_UINPUT_H
 		"u"
 #endif
 		;
 
 int main(int argc, char **argv)
 {
-	const char *input_dev = NULL;
+	const char *input_devs[MAX_INPUTS];
+	int offsets_x[MAX_INPUTS], offsets_y[MAX_INPUTS];
+	int input_count = 0;
 	const char *out_fifo = NULL;
+	const char *record_path = NULL;
+	int record_seconds = 10;
+	const char *replay_path = NULL;
+	bool profile = false;
+	const char *trace_path = NULL;
+	const char *profile_cache = NULL;
+	const char *metrics_socket = NULL;
+	bool use_backlog = false;
+	bool priority_lane = false;
 
 	bool display_help = false;
 	bool display_version = false;
 	bool verbose = false;
+	int predict_ms = 0;
+	char trailing;
+	bool use_transform = false;
+	struct transform_config transform;
+	transform_config_init(&transform);
+	bool use_deadband = false;
+	struct deadband_config deadband_config;
 #ifdef HAVE_LINUX_UINPUT_H
 	bool use_uinput = false;
 #endif
@@ -136,7 +550,52 @@ int main(int argc, char **argv)
 			display_version = true;
 			break;
 		case 'i':
-			input_dev = optarg;
+			if (input_count == MAX_INPUTS)
+			{
+				fprintf(stderr, "%s: too many input devices\n", progname);
+				return 2;
+			}
+			input_devs[input_count] = optarg;
+			offsets_x[input_count] = offsets_y[input_count] = 0;
+			++input_count;
+			break;
+		case 'R':
+			record_path = optarg;
+			break;
+		case 'S':
+			record_seconds = atoi(optarg);
+			break;
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 'f':
+			profile = true;
+			break;
+		case 'T':
+			trace_path = optarg;
+			break;
+		case 'C':
+			profile_cache = optarg;
+			break;
+		case 'M':
+			metrics_socket = optarg;
+			break;
+		case 'B':
+			if (strcmp(optarg, "priority") == 0)
+				priority_lane = true;
+			else if (strcmp(optarg, "fifo") != 0)
+			{
+				fprintf(stderr, "%s: --backlog is either fifo or priority\n", progname);
+				return 2;
+			}
+			use_backlog = true;
+			break;
+		case 'O':
+			if (input_count == 0 || sscanf(optarg, "%d,%d", &offsets_x[input_count - 1], &offsets_y[input_count - 1]) != 2)
+			{
+				fprintf(stderr, "%s: --offset x,y must follow an input device\n", progname);
+				return 2;
+			}
 			break;
 		case 'p':
 			out_fifo = optarg;
@@ -144,6 +603,33 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose = true;
 			break;
+		case 'P':
+			if (sscanf(optarg, "%d%c", &predict_ms, &trailing) != 1 || predict_ms < 0 || predict_ms > PREDICTION_MAX_LEAD_MS)
+			{
+				fprintf(stderr, "%s: --predict takes 0 .. %d ms\n", progname, PREDICTION_MAX_LEAD_MS);
+				return 2;
+			}
+			break;
+		case 'c':
+			if (!transform_config_parse_matrix(&transform, optarg))
+			{
+				fprintf(stderr, "%s: invalid calibration matrix '%s'\n", progname, optarg);
+				return 2;
+			}
+			use_transform = true;
+			break;
+		case 's':
+			transform.swap_axes = true;
+			use_transform = true;
+			break;
+		case 'D':
+			if (!deadband_config_parse(&deadband_config, optarg))
+			{
+				fprintf(stderr, "%s: invalid deadband '%s'\n", progname, optarg);
+				return 2;
+			}
+			use_deadband = true;
+			break;
 #ifdef HAVE_LINUX_UINPUT_H
 		case 'u':
 			use_uinput = true;
@@ -158,9 +644,9 @@ int main(int argc, char **argv)
 	{
 		printf("Usage: %s "
 #ifdef HAVE_LINUX_UINPUT_H
-			"{-i input_dev {-u | {-p output_fifo} } | { [--help] [--version]} [--verbose]"
+			"{{{-i input_dev [--offset x,y]}... | --replay file} {-u | {-p output_fifo} } [--predict ms] [--calibrate a,b,c,d,e,f] [--swap-axes] [--record file [--record-seconds s]] [--profile] [--trace file] [--profile-cache dir] [--deadband x[,y][mm]] [--metrics socket] [--backlog fifo|priority] | { [--help] [--version]} [--verbose]"
 #else
-			"{-i input_dev -p -o output_fifo } | { [--help] [--version]} [--verbose]"
+			"{{{-i input_dev [--offset x,y]}... | --replay file} -p output_fifo } [--predict ms] [--calibrate a,b,c,d,e,f] [--swap-axes] [--record file [--record-seconds s]] [--profile] [--trace file] [--profile-cache dir] [--deadband x[,y][mm]] [--metrics socket] [--backlog fifo|priority] | { [--help] [--version]} [--verbose]"
 #endif
 			"\n", progname);
 		return 0;
@@ -172,12 +658,18 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
-	if (!input_dev)
+	if (input_count == 0 && !replay_path)
 	{
 		fprintf(stderr, "Missing input device argument.\n");
 		return 2;
 	}
 
+	if (input_count > 0 && replay_path)
+	{
+		fprintf(stderr, "%s: can use only one of --input and --replay\n", progname);
+		return 2;
+	}
+
 #ifdef HAVE_LINUX_UINPUT_H
 	if (use_uinput && out_fifo)
 	{
@@ -185,6 +677,13 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	// uinput clones the capabilities of a real device
+	if (use_uinput && replay_path)
+	{
+		printf("%s: can't use --uinput with --replay\n", progname);
+		return 1;
+	}
+
 	// default to pipe
 	if (!use_uinput && !out_fifo)
 	{
@@ -199,63 +698,432 @@ int main(int argc, char **argv)
 	}
 #endif
 
-	if (verbose)
+	static struct translator translator;
+	struct translator_input *inputs = translator.inputs;
+	struct device_profile profiles[MAX_INPUTS];
+	translator.verbose = verbose;
+	translator.open_us = monotonic_us();
+	translator.output_wait_us = 0;
+
+	struct flight_recorder_replay replay;
+	if (replay_path)
 	{
-		printf("opening input device '%s'\n", input_dev);
+		if (!flight_recorder_replay_open(&replay, replay_path))
+			return 1;
+
+		input_count = replay.input_count;
+		for (int k = 0; k < input_count; ++k)
+		{
+			inputs[k].fd = -1;
+			inputs[k].source = NULL;
+			memset(&profiles[k], 0, sizeof(profiles[k]));
+			profiles[k].abs_bits = replay.inputs[k].abs_bits;
+			memcpy(profiles[k].absinfo, replay.inputs[k].absinfo, sizeof(profiles[k].absinfo));
+			offsets_x[k] = replay.inputs[k].offset_x;
+			offsets_y[k] = replay.inputs[k].offset_y;
+
+			if (!mtdev_setup_from_absinfo(&inputs[k].mtd, profiles[k].abs_bits, profiles[k].absinfo))
+				return 1;
+		}
 	}
-	int fd = open(input_dev, O_RDONLY | O_NONBLOCK);
-	if (fd < 0)
+
+	for (int k = 0; k < input_count && !replay_path; ++k)
 	{
-		perror("can't open input device");
-		return 1;
+		if (verbose)
+		{
+			printf("opening input device '%s'\n", input_devs[k]);
+		}
+		int fd = open(input_devs[k], O_RDONLY | O_NONBLOCK);
+		if (fd < 0)
+		{
+			perror("can't open input device");
+			return 1;
+		}
+		inputs[k].fd = fd;
+
+		const bool cached = profile_cache && device_profile_load(&profiles[k], profile_cache, fd);
+		if (!cached)
+		{
+			if (!device_profile_probe(&profiles[k], fd))
+				return 1;
+			if (profile_cache)
+				device_profile_save(&profiles[k], profile_cache);
+		}
+
+		if (verbose)
+		{
+			if (cached)
+			{
+				printf("using cached device profile\n");
+				device_profile_print(&profiles[k]);
+			}
+			else if (!print_input_device_info(fd))
+				return 1;
+		}
+
+		// a cached profile spares mtdev probing the device again
+		if (cached)
+		{
+			if (!mtdev_setup_from_absinfo(&inputs[k].mtd, profiles[k].abs_bits, profiles[k].absinfo))
+				return 1;
+		}
+		else if (mtdev_open(&inputs[k].mtd, fd) != 0)
+		{
+			fprintf(stderr, "mtdev_open failed!\n");
+			return 1;
+		}
+
+		struct evdev_event_source *source = (struct evdev_event_source*)malloc(sizeof(*source));
+		if (!source)
+		{
+			fprintf(stderr, "can't allocate event source\n");
+			return 4;
+		}
+		if (!evdev_event_source_create(source, fd, &profiles[k]))
+			return 4;
+		inputs[k].source = (struct event_source*)source;
+
+		if (verbose)
+			printf("reading up to %d events at once\n", source->base.capacity);
+	}
+	translator.input_count = input_count;
+
+	for (int k = 0; k < input_count; ++k)
+	{
+		inputs[k].frame_count = 0;
+		inputs[k].reads = 0;
+		inputs[k].frames = 0;
+		inputs[k].frame_begin_ns = 0;
+		inputs[k].slot = 0;
+		memset(inputs[k].active_slots, 0, sizeof(inputs[k].active_slots));
+	}
+
+	struct flight_recorder *recorder = NULL;
+	if (record_path)
+	{
+		recorder = (struct flight_recorder*)malloc(sizeof(*recorder));
+		if (!recorder)
+		{
+			fprintf(stderr, "can't allocate flight recorder\n");
+			return 4;
+		}
+		int events_per_second = 0;
+		for (int k = 0; k < input_count; ++k)
+			events_per_second += evdev_events_per_packet(&profiles[k]) * RECORD_PACKET_RATE / 2;
+		if (!flight_recorder_create(recorder, record_path, record_seconds, events_per_second))
+			return 4;
+		if (verbose)
+			printf("flight recorder: rings of %" PRIu64 " events, %" PRIu64 " KiB in all\n", recorder->input.mask + 1,
+					4*(recorder->input.mask + 1)*sizeof(struct flight_recorder_record)/1024);
+
+		for (int k = 0; k < input_count; ++k)
+			flight_recorder_add_input(recorder, profiles[k].abs_bits, profiles[k].absinfo, offsets_x[k], offsets_y[k]);
+
+		// poll() returns EINTR regardless, SA_RESTART keeps a blocking write
+		// to the output going instead of tearing the frame
+		install_signal_handler(SIGUSR1, request_dump, SA_RESTART);
+	}
+	translator.recorder = recorder;
+
+	struct profiler *profiler = NULL;
+	if (profile)
+	{
+		profiler = (struct profiler*)malloc(sizeof(*profiler));
+		if (!profiler)
+		{
+			fprintf(stderr, "can't allocate profiler\n");
+			return 4;
+		}
+		if (!profiler_create(profiler))
+			return 4;
+
+		install_signal_handler(SIGUSR2, request_profile, SA_RESTART);
 	}
+	translator.profiler = profiler;
 
-	if (verbose)
+	struct trace_writer *tracer = NULL;
+	if (trace_path)
 	{
-		if (!print_input_device_info(fd))
+		tracer = (struct trace_writer*)malloc(sizeof(*tracer));
+		if (!tracer)
+		{
+			fprintf(stderr, "can't allocate trace writer\n");
+			return 4;
+		}
+		if (!trace_writer_create(tracer, trace_path, input_count))
 			return 1;
 	}
+	translator.tracer = tracer;
+
+	struct metrics *metrics = NULL;
+	if (metrics_socket)
+	{
+		// the counters are laid out on their own cache lines
+		if (posix_memalign((void**)&metrics, METRICS_CACHE_LINE, sizeof(*metrics)) != 0)
+		{
+			fprintf(stderr, "can't allocate metrics\n");
+			return 4;
+		}
+		if (!metrics_create(metrics, metrics_socket, input_count))
+			return 1;
+	}
+	translator.metrics = metrics;
+
+	// several panels are merged into a single device
+	struct panel_merger *merger = NULL;
+	const struct input_absinfo *absinfo = profiles[0].absinfo;
+	int slot_count = mtdev_slot_count(&inputs[0].mtd);
+	if (input_count > 1)
+	{
+		merger = (struct panel_merger*)malloc(sizeof(*merger));
+		if (!merger)
+		{
+			fprintf(stderr, "can't allocate panel merger\n");
+			return 4;
+		}
+		panel_merger_create(merger);
+		for (int k = 0; k < input_count; ++k)
+		{
+			inputs[k].ed = panel_merger_add_panel(merger, profiles[k].absinfo, offsets_x[k], offsets_y[k]);
+			if (!inputs[k].ed)
+				return 4;
+		}
+		absinfo = merger->absinfo;
+		slot_count = merger->absinfo[ABS_MT_SLOT].maximum + 1;
+	}
+
+	// axis ranges of the translated positions
+	struct input_absinfo target_absinfo[ABS_CNT];
+	memcpy(target_absinfo, absinfo, sizeof(target_absinfo));
+	if (use_transform)
+		transform_absinfo(&transform, target_absinfo);
 
 	struct event_dispatcher *base = NULL;
+	int output_fd = -1;
 	if (out_fifo)
 	{
-		struct pipe_event_dispatcher *ed = (struct pipe_event_dispatcher*)malloc(sizeof(ed));
+		struct pipe_event_dispatcher *ed = (struct pipe_event_dispatcher*)malloc(sizeof(*ed));
 		if (!ed)
 		{
 			fprintf(stderr, "can't allocate dispatcher instance\n");
 			return 4;
 		}
-		if (!pipe_event_dispatcher_create(ed, out_fifo))
+		const int64_t output_open_us = monotonic_us();
+		if (!pipe_event_dispatcher_create(ed, out_fifo, &quit_requested))
 		{
 			fprintf(stderr, "pipe_event_dispatcher_create failed!\n");
 			return 4;
 		}
+		translator.output_wait_us = monotonic_us() - output_open_us;
+		if (metrics)
+		{
+			ed->metrics = &metrics->output;
+			metrics_set_backlog_fd(metrics, ed->fifo_fd);
+		}
+		output_fd = ed->fifo_fd;
 		base = (struct event_dispatcher*)ed;
 	}
 #ifdef HAVE_LINUX_UINPUT_H
 	else
 	{
 		// uinput
-		struct uinput_event_dispatcher *ed = (struct uinput_event_dispatcher*)malloc(sizeof(ed));
+		struct uinput_event_dispatcher *ed = (struct uinput_event_dispatcher*)malloc(sizeof(*ed));
 		if (!ed)
 		{
 			fprintf(stderr, "can't allocate dispatcher instance\n");
 			return 4;
 		}
-		if (!uinput_event_dispatcher_create(ed, out_fifo))
+		if (!uinput_event_dispatcher_create(ed, &profiles[0], target_absinfo, slot_count))
 		{
 			fprintf(stderr, "uinput_event_dispatcher_create failed!\n");
 			return 4;
 		}
+		if (metrics)
+			ed->metrics = &metrics->output;
 		base = (struct event_dispatcher*)ed;
 	}
 #endif
 
-	int r = translate_loop(fd, base);
-	close(fd);
+	// leave the loop cleanly so that the summaries get printed and the fifo
+	// removed; not restarted, so that a write stuck on a stalled reader gives
+	// up, and a second signal takes the default action
+	install_signal_handler(SIGINT, request_quit, SA_RESETHAND);
+	install_signal_handler(SIGTERM, request_quit, SA_RESETHAND);
 
-	base->destroy(base);
-	free(base);
+	// recorded at the very end, a dump shows what the consumer got
+	if (recorder)
+	{
+		struct recording_event_dispatcher *ed = (struct recording_event_dispatcher*)malloc(sizeof(*ed));
+		if (!ed)
+		{
+			fprintf(stderr, "can't allocate dispatcher instance\n");
+			return 4;
+		}
+		if (!recording_event_dispatcher_create(ed, base, recorder))
+		{
+			fprintf(stderr, "recording_event_dispatcher_create failed!\n");
+			return 4;
+		}
+		base = (struct event_dispatcher*)ed;
+	}
+
+	// the queue sits right in front of the output so that it sees the final frames
+	struct backlog_event_dispatcher *backlog = NULL;
+	if (use_backlog)
+	{
+		if (output_fd < 0)
+		{
+			fprintf(stderr, "%s: --backlog needs --pipe\n", progname);
+			return 1;
+		}
+
+		backlog = (struct backlog_event_dispatcher*)malloc(sizeof(*backlog));
+		if (!backlog)
+		{
+			fprintf(stderr, "can't allocate dispatcher instance\n");
+			return 4;
+		}
+		if (!backlog_event_dispatcher_create(backlog, base, output_fd, priority_lane))
+		{
+			fprintf(stderr, "backlog_event_dispatcher_create failed!\n");
+			return 4;
+		}
+		if (metrics)
+			backlog->metrics = metrics_use_queue(metrics);
+		base = (struct event_dispatcher*)backlog;
+	}
+	translator.backlog = backlog;
+
+	if (predict_ms > 0)
+	{
+		struct prediction_event_dispatcher *ed = (struct prediction_event_dispatcher*)malloc(sizeof(*ed));
+		if (!ed)
+		{
+			fprintf(stderr, "can't allocate dispatcher instance\n");
+			return 4;
+		}
+		if (!prediction_event_dispatcher_create(ed, base, slot_count, predict_ms,
+				&target_absinfo[ABS_MT_POSITION_X], &target_absinfo[ABS_MT_POSITION_Y]))
+		{
+			fprintf(stderr, "prediction_event_dispatcher_create failed!\n");
+			return 4;
+		}
+		base = (struct event_dispatcher*)ed;
+	}
+
+	if (use_transform)
+	{
+		struct transform_event_dispatcher *ed = (struct transform_event_dispatcher*)malloc(sizeof(*ed));
+		if (!ed)
+		{
+			fprintf(stderr, "can't allocate dispatcher instance\n");
+			return 4;
+		}
+		if (!transform_event_dispatcher_create(ed, base, slot_count, &transform, absinfo))
+		{
+			fprintf(stderr, "transform_event_dispatcher_create failed!\n");
+			return 4;
+		}
+		base = (struct event_dispatcher*)ed;
+	}
+
+	// first in line so that the thresholds are in device units
+	struct deadband_event_dispatcher *deadband = NULL;
+	if (use_deadband)
+	{
+		deadband = (struct deadband_event_dispatcher*)malloc(sizeof(*deadband));
+		if (!deadband)
+		{
+			fprintf(stderr, "can't allocate dispatcher instance\n");
+			return 4;
+		}
+		if (!deadband_event_dispatcher_create(deadband, base, slot_count, &deadband_config, absinfo, verbose))
+		{
+			fprintf(stderr, "deadband_event_dispatcher_create failed!\n");
+			return 4;
+		}
+		base = (struct event_dispatcher*)deadband;
+	}
+
+	if (merger)
+		panel_merger_connect(merger, base);
+	else
+		inputs[0].ed = base;
+
+	int r;
+	if (replay_path)
+	{
+		r = replay_loop(&translator, &replay);
+		flight_recorder_replay_close(&replay);
+	}
+	else
+		r = translate_loop(&translator);
+
+	for (int k = 0; k < input_count; ++k)
+	{
+		if (verbose && inputs[k].source && inputs[k].frames > 0)
+		{
+			printf("input %d: %" PRIu64 " reads for %" PRIu64 " frames, %.2f reads/frame\n", k,
+				inputs[k].reads, inputs[k].frames, (double)inputs[k].reads / inputs[k].frames);
+		}
+
+		if (inputs[k].source)
+		{
+			inputs[k].source->destroy(inputs[k].source);
+			free(inputs[k].source);
+		}
+		mtdev_close(&inputs[k].mtd);
+		if (inputs[k].fd >= 0)
+			close(inputs[k].fd);
+	}
+
+	if (tracer)
+	{
+		trace_writer_destroy(tracer);
+		free(tracer);
+	}
+
+	if (profiler)
+	{
+		profiler_print(profiler, stdout);
+		profiler_destroy(profiler);
+		free(profiler);
+	}
+
+	// the output fd is about to be closed
+	if (metrics)
+		metrics_set_backlog_fd(metrics, -1);
+
+	if (deadband && verbose)
+		deadband_event_dispatcher_print_stats(deadband, stdout);
+
+	if (backlog && verbose)
+		backlog_event_dispatcher_print_stats(backlog, stdout);
+
+	if (merger)
+	{
+		panel_merger_destroy(merger);
+		free(merger);
+	}
+	else
+	{
+		base->destroy(base);
+		free(base);
+	}
+
+	// the backlog counts its last writes while it is torn down
+	if (metrics)
+	{
+		metrics_destroy(metrics);
+		free(metrics);
+	}
+
+	// the output stage records into it up to the end
+	if (recorder)
+	{
+		flight_recorder_destroy(recorder);
+		free(recorder);
+	}
 
 	return r;
 }
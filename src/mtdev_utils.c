@@ -0,0 +1,107 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "mtdev_utils.h"
+
+// signal to noise ratios mtdev_configure() derives a missing fuzz from
+static const int MTDEV_SN_COORD = 250;
+static const int MTDEV_SN_WIDTH = 100;
+static const int MTDEV_SN_ORIENT = 10;
+
+// slots mtdev emulates for devices without ABS_MT_SLOT (DIM_FINGER)
+static const int MTDEV_TYPE_A_SLOTS = 32;
+
+static bool has_axis(uint64_t abs_bits, int code)
+{
+	return (abs_bits >> code) & 1;
+}
+
+static void default_fuzz(struct mtdev_caps *caps, int code, int sn)
+{
+	const int i = code - ABS_MT_TOUCH_MAJOR;
+	struct input_absinfo *abs = &caps->abs[i];
+	if (!caps->has_abs[i] || abs->fuzz)
+		return;
+	abs->fuzz = (abs->maximum - abs->minimum) / sn;
+}
+
+bool mtdev_setup_from_absinfo(struct mtdev *mtd, uint64_t abs_bits, const struct input_absinfo *absinfo)
+{
+	assert(mtd != NULL);
+	assert(absinfo != NULL);
+	if (mtdev_init(mtd) != 0)
+	{
+		fprintf(stderr, "mtdev_init failed!\n");
+		return false;
+	}
+
+	// the same as mtdev_configure() reads from the device
+	struct mtdev_caps *caps = &mtd->caps;
+	caps->has_slot = has_axis(abs_bits, ABS_MT_SLOT);
+	if (caps->has_slot)
+		caps->slot = absinfo[ABS_MT_SLOT];
+
+	for (int i = 0; i < MT_ABS_SIZE; ++i)
+	{
+		const int code = ABS_MT_TOUCH_MAJOR + i;
+		caps->has_abs[i] = has_axis(abs_bits, code);
+		if (caps->has_abs[i])
+			caps->abs[i] = absinfo[code];
+	}
+
+	const int x = ABS_MT_POSITION_X - ABS_MT_TOUCH_MAJOR;
+	const int y = ABS_MT_POSITION_Y - ABS_MT_TOUCH_MAJOR;
+	caps->has_mtdata = caps->has_abs[x] && caps->has_abs[y];
+
+	// single-touch ranges stand in for missing MT ones
+	if (!caps->has_abs[x] && has_axis(abs_bits, ABS_X))
+		caps->abs[x] = absinfo[ABS_X];
+	if (!caps->has_abs[y] && has_axis(abs_bits, ABS_Y))
+		caps->abs[y] = absinfo[ABS_Y];
+
+	// mtdev filters type A positions with it
+	default_fuzz(caps, ABS_MT_POSITION_X, MTDEV_SN_COORD);
+	default_fuzz(caps, ABS_MT_POSITION_Y, MTDEV_SN_COORD);
+	default_fuzz(caps, ABS_MT_TOUCH_MAJOR, MTDEV_SN_WIDTH);
+	default_fuzz(caps, ABS_MT_TOUCH_MINOR, MTDEV_SN_WIDTH);
+	default_fuzz(caps, ABS_MT_WIDTH_MAJOR, MTDEV_SN_WIDTH);
+	default_fuzz(caps, ABS_MT_WIDTH_MINOR, MTDEV_SN_WIDTH);
+	default_fuzz(caps, ABS_MT_ORIENTATION, MTDEV_SN_ORIENT);
+
+	return true;
+}
+
+int mtdev_slot_count(const struct mtdev *mtd)
+{
+	assert(mtd != NULL);
+	return mtd->caps.has_slot ? mtd->caps.slot.maximum + 1 : MTDEV_TYPE_A_SLOTS;
+}
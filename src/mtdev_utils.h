@@ -0,0 +1,52 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef MTDEV_UTILS_H
+#define MTDEV_UTILS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/input.h>
+#include <mtdev-plumbing.h>
+
+/**
+ * \brief Initialize mtdev with known device capabilities instead of probing a device.
+ *
+ * \a abs_bits has a bit set for every axis of the device and \a absinfo is
+ * a table of ABS_CNT items with the axis ranges. Axes without a fuzz get
+ * the same default fuzz mtdev_configure() gives them, so mtdev behaves as
+ * if it had probed the device. Release with mtdev_close().
+ */
+bool mtdev_setup_from_absinfo(struct mtdev *mtd, uint64_t abs_bits, const struct input_absinfo *absinfo);
+
+/**
+ * \brief Number of slots in the mtdev output, devices without ABS_MT_SLOT get 32 emulated ones.
+ */
+int mtdev_slot_count(const struct mtdev *mtd);
+
+#endif // MTDEV_UTILS_H
@@ -0,0 +1,392 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "panel_merger.h"
+
+// mtdev emulates this many slots for devices without ABS_MT_SLOT
+static const int PANEL_TYPE_A_SLOTS = 32;
+
+// tracking IDs wrap around like the ones of the kernel
+static const int PANEL_TRACKING_ID_MASK = 0xffff;
+
+// BTN_TOOL_* keys reporting the number of contacts, counted over all panels instead of merged
+static const uint16_t PANEL_FINGER_COUNT_KEYS =
+		1 << (BTN_TOOL_FINGER - BTN_DIGI) | 1 << (BTN_TOOL_DOUBLETAP - BTN_DIGI) |
+		1 << (BTN_TOOL_TRIPLETAP - BTN_DIGI) | 1 << (BTN_TOOL_QUADTAP - BTN_DIGI) |
+		1 << (BTN_TOOL_QUINTTAP - BTN_DIGI);
+
+static bool panel_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count);
+static void panel_event_dispatcher_destroy(struct event_dispatcher *base);
+
+void panel_merger_create(struct panel_merger *self)
+{
+	assert(self != NULL);
+	self->next = NULL;
+	self->panel_count = 0;
+	self->out_slot = 0;
+	self->digi_keys = 0;
+	self->finger_count = false;
+	memset(self->active_slots, 0, sizeof(self->active_slots));
+	self->tracking_id = 0;
+	self->pointer_panel = -1;
+	memset(self->absinfo, 0, sizeof(self->absinfo));
+}
+
+static void extend_range(struct input_absinfo *merged, const struct input_absinfo *panel, int offset, bool first)
+{
+	const int minimum = panel->minimum + offset;
+	const int maximum = panel->maximum + offset;
+	if (first || minimum < merged->minimum)
+		merged->minimum = minimum;
+	if (first || maximum > merged->maximum)
+		merged->maximum = maximum;
+}
+
+struct event_dispatcher *panel_merger_add_panel(struct panel_merger *self, const struct input_absinfo *absinfo,
+		int offset_x, int offset_y)
+{
+	assert(self != NULL);
+	assert(absinfo != NULL);
+	if (self->panel_count == PANEL_MERGER_MAX_PANELS)
+	{
+		fprintf(stderr, "panel_merger_add_panel: too many panels\n");
+		return NULL;
+	}
+
+	const bool first = self->panel_count == 0;
+	struct panel_event_dispatcher *panel = &self->panels[self->panel_count];
+	const struct input_absinfo *slot = &absinfo[ABS_MT_SLOT];
+	panel->slot_count = slot->maximum > 0 ? slot->maximum + 1 : PANEL_TYPE_A_SLOTS;
+	const struct panel_event_dispatcher *previous = first ? NULL : &self->panels[self->panel_count - 1];
+	panel->slot_base = previous ? previous->slot_base + previous->slot_count : 0;
+	if (panel->slot_base + panel->slot_count > PANEL_MERGER_MAX_SLOTS)
+	{
+		fprintf(stderr, "panel_merger_add_panel: more than %d slots in total\n", PANEL_MERGER_MAX_SLOTS);
+		return NULL;
+	}
+
+	panel->base.dispatch = panel_event_dispatcher_dispatch;
+	panel->base.destroy = panel_event_dispatcher_destroy;
+	panel->merger = self;
+	panel->index = self->panel_count;
+	panel->offset_x = offset_x;
+	panel->offset_y = offset_y;
+	panel->slot = 0;
+	panel->digi_keys = 0;
+	panel->has_pointer = false;
+	panel->pointer_x = panel->pointer_y = 0;
+	panel->frame_count = 0;
+
+	// everything else is described by the first panel
+	if (first)
+		memcpy(self->absinfo, absinfo, sizeof(self->absinfo));
+
+	extend_range(&self->absinfo[ABS_X], &absinfo[ABS_X], offset_x, first);
+	extend_range(&self->absinfo[ABS_Y], &absinfo[ABS_Y], offset_y, first);
+	extend_range(&self->absinfo[ABS_MT_POSITION_X], &absinfo[ABS_MT_POSITION_X], offset_x, first);
+	extend_range(&self->absinfo[ABS_MT_POSITION_Y], &absinfo[ABS_MT_POSITION_Y], offset_y, first);
+
+	self->absinfo[ABS_MT_SLOT].minimum = 0;
+	self->absinfo[ABS_MT_SLOT].maximum = panel->slot_base + panel->slot_count - 1;
+	self->absinfo[ABS_MT_TRACKING_ID].minimum = 0;
+	self->absinfo[ABS_MT_TRACKING_ID].maximum = PANEL_TRACKING_ID_MASK;
+
+	++self->panel_count;
+	return &panel->base;
+}
+
+void panel_merger_connect(struct panel_merger *self, struct event_dispatcher *next)
+{
+	assert(self != NULL);
+	self->next = next;
+}
+
+void panel_merger_destroy(struct panel_merger *self)
+{
+	assert(self != NULL);
+	if (self->next)
+	{
+		self->next->destroy(self->next);
+		free(self->next);
+		self->next = NULL;
+	}
+}
+
+static void append_event(struct input_event *out, int *n, const struct timeval *time, uint16_t type, uint16_t code, int32_t value)
+{
+	struct input_event *ev = &out[(*n)++];
+	ev->time = *time;
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+/**
+ * Update the key state of the panel and return true if the merged state changes.
+ */
+static bool merge_digi_key(struct panel_event_dispatcher *panel, struct input_event *ev)
+{
+	struct panel_merger *merger = panel->merger;
+	const uint16_t bit = 1 << (ev->code - BTN_DIGI);
+
+	if (ev->value)
+		panel->digi_keys |= bit;
+	else
+		panel->digi_keys &= ~bit;
+
+	uint16_t merged = 0;
+	for (int i = 0; i < merger->panel_count; ++i)
+		merged |= merger->panels[i].digi_keys;
+
+	if ((merged & bit) == (merger->digi_keys & bit))
+		return false;
+
+	merger->digi_keys ^= bit;
+	ev->value = (merged & bit) != 0;
+	return true;
+}
+
+/**
+ * The finger count key the kernel reports for \a count contacts, 0 for none.
+ */
+static int finger_count_key(int count)
+{
+	switch (count)
+	{
+	case 0:
+		return 0;
+	case 1:
+		return BTN_TOOL_FINGER;
+	case 2:
+		return BTN_TOOL_DOUBLETAP;
+	case 3:
+		return BTN_TOOL_TRIPLETAP;
+	case 4:
+		return BTN_TOOL_QUADTAP;
+	default:
+		return BTN_TOOL_QUINTTAP;
+	}
+}
+
+/**
+ * Send the finger count keys that changed with the number of contacts on all panels;
+ * like the kernel, all of them, the ones the device lacks are dropped by uinput.
+ */
+static void report_finger_count(struct panel_merger *merger, struct input_event *out, int *n, const struct timeval *time)
+{
+	if (!merger->finger_count)
+		return;
+
+	int count = 0;
+	for (int i = 0; i < PANEL_MERGER_MAX_SLOTS / 64; ++i)
+		count += __builtin_popcountll(merger->active_slots[i]);
+
+	const int key = finger_count_key(count);
+	for (int code = BTN_DIGI; code < BTN_DIGI + 16; ++code)
+	{
+		const uint16_t bit = 1 << (code - BTN_DIGI);
+		if (!(PANEL_FINGER_COUNT_KEYS & bit))
+			continue;
+
+		const bool down = code == key;
+		if (down == ((merger->digi_keys & bit) != 0))
+			continue;
+
+		if (down)
+			merger->digi_keys |= bit;
+		else
+			merger->digi_keys &= ~bit;
+		append_event(out, n, time, EV_KEY, code, down);
+	}
+}
+
+/**
+ * Hand the merged pointer over when the touch state of a panel changes,
+ * the new pointer panel gets its current position sent.
+ */
+static void update_pointer_panel(struct panel_event_dispatcher *panel, bool touch,
+		struct input_event *out, int *n, const struct timeval *time)
+{
+	struct panel_merger *merger = panel->merger;
+
+	if (touch)
+	{
+		if (merger->pointer_panel < 0)
+			merger->pointer_panel = panel->index;
+		return;
+	}
+
+	if (merger->pointer_panel != panel->index)
+		return;
+
+	merger->pointer_panel = -1;
+	const uint16_t bit = 1 << (BTN_TOUCH - BTN_DIGI);
+	for (int i = 0; i < merger->panel_count; ++i)
+	{
+		struct panel_event_dispatcher *other = &merger->panels[i];
+		if (other == panel || !(other->digi_keys & bit))
+			continue;
+
+		merger->pointer_panel = i;
+		if (other->has_pointer)
+		{
+			append_event(out, n, time, EV_ABS, ABS_X, other->pointer_x);
+			append_event(out, n, time, EV_ABS, ABS_Y, other->pointer_y);
+		}
+		break;
+	}
+}
+
+static bool flush_frame(struct panel_event_dispatcher *panel)
+{
+	struct panel_merger *merger = panel->merger;
+	assert(merger->next != NULL);
+
+	struct input_event *out = merger->out;
+	int n = 0;
+	for (int i = 0; i < panel->frame_count; ++i)
+	{
+		struct input_event ev = panel->frame[i];
+
+		if (ev.type == EV_ABS)
+		{
+			if (ev.code == ABS_MT_SLOT)
+			{
+				// emitted lazily with the next event of the slot
+				panel->slot = ev.value;
+				continue;
+			}
+			else if (ev.code >= ABS_MT_TOUCH_MAJOR && ev.code <= ABS_MAX)
+			{
+				if (panel->slot < 0 || panel->slot >= panel->slot_count)
+					continue;
+
+				const int slot = panel->slot_base + panel->slot;
+				if (slot != merger->out_slot)
+				{
+					append_event(out, &n, &ev.time, EV_ABS, ABS_MT_SLOT, slot);
+					merger->out_slot = slot;
+				}
+
+				if (ev.code == ABS_MT_POSITION_X)
+					ev.value += panel->offset_x;
+				else if (ev.code == ABS_MT_POSITION_Y)
+					ev.value += panel->offset_y;
+				else if (ev.code == ABS_MT_TRACKING_ID)
+				{
+					uint64_t *word = &merger->active_slots[slot / 64];
+					const uint64_t bit = (uint64_t)1 << (slot % 64);
+					if (ev.value >= 0)
+					{
+						*word |= bit;
+						// mtdev reports a tracking ID only when a new contact starts
+						ev.value = merger->tracking_id;
+						merger->tracking_id = (merger->tracking_id + 1) & PANEL_TRACKING_ID_MASK;
+					}
+					else
+						*word &= ~bit;
+				}
+			}
+			else if (ev.code == ABS_X || ev.code == ABS_Y)
+			{
+				panel->has_pointer = true;
+				if (ev.code == ABS_X)
+					ev.value = panel->pointer_x = ev.value + panel->offset_x;
+				else
+					ev.value = panel->pointer_y = ev.value + panel->offset_y;
+
+				// the other panels would make the pointer jump back and forth
+				if (merger->pointer_panel >= 0 && merger->pointer_panel != panel->index)
+					continue;
+			}
+		}
+		else if (ev.type == EV_KEY && ev.code >= BTN_DIGI && ev.code < BTN_DIGI + 16)
+		{
+			const uint16_t bit = 1 << (ev.code - BTN_DIGI);
+			if (PANEL_FINGER_COUNT_KEYS & bit)
+			{
+				// sent ahead of SYN_REPORT once the contacts of the frame are known
+				merger->finger_count = true;
+				continue;
+			}
+			if (ev.code == BTN_TOUCH)
+				update_pointer_panel(panel, ev.value != 0, out, &n, &ev.time);
+			if (!merge_digi_key(panel, &ev))
+				continue;
+		}
+		else if (ev.type == EV_MSC && ev.code == MSC_TIMESTAMP)
+		{
+			// the panels do not share a clock
+			continue;
+		}
+		else if (ev.type == EV_SYN && ev.code == SYN_REPORT)
+			report_finger_count(merger, out, &n, &ev.time);
+
+		out[n++] = ev;
+	}
+
+	panel->frame_count = 0;
+	return merger->next->dispatch(merger->next, out, n);
+}
+
+static bool panel_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	assert(base != NULL);
+	struct panel_event_dispatcher* const self = (struct panel_event_dispatcher*)base;
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (self->frame_count == PANEL_MERGER_MAX_EVENTS)
+		{
+			// frame too long, pass on what we have so far
+			if (!flush_frame(self))
+				return false;
+		}
+
+		self->frame[self->frame_count++] = events[i];
+
+		if (events[i].type == EV_SYN && events[i].code == SYN_REPORT)
+		{
+			if (!flush_frame(self))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void panel_event_dispatcher_destroy(struct event_dispatcher *base)
+{
+	(void)base; // the panels are owned by the merger
+}
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef PANEL_MERGER_H
+#define PANEL_MERGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_dispatcher.h"
+
+#define PANEL_MERGER_MAX_PANELS 8
+
+/**
+ * \brief Maximum number of slots of the merged device, enough for every panel to be of type A.
+ */
+#define PANEL_MERGER_MAX_SLOTS 256
+
+/**
+ * \brief Maximum number of events buffered for a single frame of a panel.
+ */
+#define PANEL_MERGER_MAX_EVENTS 512
+
+struct panel_merger;
+
+/**
+ * \brief Dispatcher receiving the events of a single panel.
+ */
+struct panel_event_dispatcher
+{
+	struct event_dispatcher base;
+	struct panel_merger *merger;
+	int index;
+
+	int slot_base, slot_count;
+	int offset_x, offset_y;
+
+	int slot; // current slot of the panel stream
+	uint16_t digi_keys; // state of BTN_DIGI .. BTN_DIGI + 15
+	bool has_pointer; // the panel reported ABS_X/ABS_Y
+	int pointer_x, pointer_y; // last ABS_X/ABS_Y of the panel, offset applied
+
+	int frame_count;
+	struct input_event frame[PANEL_MERGER_MAX_EVENTS];
+};
+
+/**
+ * \brief Merges several multitouch panels into a single multitouch device.
+ *
+ * Each panel gets a disjoint range of slots and its positions are offset
+ * into a shared coordinate space. Frames of each panel are buffered up to
+ * SYN_REPORT and passed on as a whole so that frames of different panels
+ * never interleave. Each new contact gets the next tracking ID of the
+ * merged device, BTN_TOUCH and the other BTN_DIGI keys report the union of
+ * all panels, BTN_TOOL_FINGER .. BTN_TOOL_QUINTTAP the number of contacts
+ * on all of them, and ABS_X/ABS_Y follow the panel touched first, moving
+ * on to another touched panel when it is released.
+ */
+struct panel_merger
+{
+	struct event_dispatcher *next;
+
+	int panel_count;
+	struct panel_event_dispatcher panels[PANEL_MERGER_MAX_PANELS];
+
+	int out_slot; // current slot as seen by the next dispatcher
+	uint16_t digi_keys; // merged state of BTN_DIGI .. BTN_DIGI + 15
+	bool finger_count; // a panel reports the BTN_TOOL_* finger count keys
+	uint64_t active_slots[PANEL_MERGER_MAX_SLOTS / 64]; // merged slots with a contact
+	int tracking_id; // next tracking ID of the merged device
+	int pointer_panel; // panel ABS_X/ABS_Y are taken from, -1 while none is touched
+
+	// axis ranges of the merged device
+	struct input_absinfo absinfo[ABS_CNT];
+
+	// an ABS_MT_SLOT may go ahead of every event, the ABS_X/ABS_Y of the next pointer panel ahead of a BTN_TOUCH release,
+	// the finger count keys ahead of SYN_REPORT
+	struct input_event out[3*PANEL_MERGER_MAX_EVENTS + 5];
+};
+
+void panel_merger_create(struct panel_merger *self);
+
+/**
+ * \brief Add a panel with axis ranges \a absinfo (a table of ABS_CNT items) placed at the given offset.
+ *
+ * \return dispatcher to pass the mtdev output of the panel to or NULL on error
+ */
+struct event_dispatcher *panel_merger_add_panel(struct panel_merger *self, const struct input_absinfo *absinfo,
+		int offset_x, int offset_y);
+
+/**
+ * \brief Set the dispatcher the merged events go to. The merger takes ownership of \a next.
+ */
+void panel_merger_connect(struct panel_merger *self, struct event_dispatcher *next);
+
+void panel_merger_destroy(struct panel_merger *self);
+
+#endif // PANEL_MERGER_H
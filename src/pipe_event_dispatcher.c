@@ -30,27 +30,41 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
 #include "pipe_event_dispatcher.h"
+#include "input_utils.h"
 
 static bool pipe_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count);
 static void pipe_event_dispatcher_destroy(struct event_dispatcher *base);
 
-bool pipe_event_dispatcher_create(struct pipe_event_dispatcher *self, const char *fifo_name)
+static int open_fifo(const char *fifo_name, const volatile sig_atomic_t *cancel)
+{
+	int fd;
+	do
+		fd = open(fifo_name, O_WRONLY);
+	while (fd < 0 && errno == EINTR && !(cancel && *cancel));
+	return fd;
+}
+
+bool pipe_event_dispatcher_create(struct pipe_event_dispatcher *self, const char *fifo_name,
+		const volatile sig_atomic_t *cancel)
 {
 	assert(self != NULL);
 	self->base.dispatch = pipe_event_dispatcher_dispatch;
 	self->base.destroy = pipe_event_dispatcher_destroy;
 
 	self->fifo_fd = -1;
+	self->metrics = NULL;
+	self->cancel = cancel;
 	self->unlink_on_close = false;
 	self->fifo_name = NULL;
 
-	int fd = open(fifo_name, O_WRONLY);
+	int fd = open_fifo(fifo_name, cancel);
 	if (fd >= 0)
 	{
 		struct stat s;
@@ -76,7 +90,7 @@ bool pipe_event_dispatcher_create(struct pipe_event_dispatcher *self, const char
 		int r = mkfifo(fifo_name, 0660);
 		if (r >= 0)
 		{
-			fd = open(fifo_name, O_WRONLY);
+			fd = open_fifo(fifo_name, cancel);
 			if (fd < 0)
 			{
 				unlink(fifo_name);
@@ -101,9 +115,10 @@ static bool pipe_event_dispatcher_dispatch(struct event_dispatcher *base, const
 	assert(base != NULL);
 	struct pipe_event_dispatcher* const self = (struct pipe_event_dispatcher*)base;
 
-	const size_t N = sizeof(*events)*count;
-	if (write(self->fifo_fd, events, N) != N)
+	if (!write_events(self->fifo_fd, events, count, self->metrics, self->cancel))
 	{
+		if (self->cancel && *self->cancel)
+			return false;
 		perror("pipe_event_dispatcher_dispatch: write() failed!");
 		return false;
 	}
@@ -28,16 +28,29 @@
 #ifndef PIPE_EVENT_DISPATCHER_H
 #define PIPE_EVENT_DISPATCHER_H
 
+#include <signal.h>
+
 #include "event_dispatcher.h"
 
+struct metrics_output;
+
 struct pipe_event_dispatcher
 {
 	struct event_dispatcher base;
 	int fifo_fd;
+	struct metrics_output *metrics; // NULL when not collected
+	const volatile sig_atomic_t *cancel; // stops blocking opens and writes once set, may be NULL
 	bool unlink_on_close;
 	char *fifo_name;
 };
 
-bool pipe_event_dispatcher_create(struct pipe_event_dispatcher *self, const char *fifo_name);
+/**
+ * \brief Open \a fifo_name for writing, creating it if it does not exist.
+ *
+ * Opening waits for a reader; the wait and later writes give up when
+ * interrupted by a signal after \a cancel (may be NULL) was set.
+ */
+bool pipe_event_dispatcher_create(struct pipe_event_dispatcher *self, const char *fifo_name,
+		const volatile sig_atomic_t *cancel);
 
 #endif // PIPE_EVENT_DISPATCHER_H
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "prediction_event_dispatcher.h"
+
+// samples needed before a contact is predicted
+static const unsigned PREDICTION_MIN_SAMPLES = 3;
+
+// a longer gap between samples starts a new history
+static const int64_t PREDICTION_MAX_GAP_US = 50000;
+
+// squared cosine of the largest turn between two steps that still counts as smooth motion (45 degrees)
+static const double PREDICTION_MIN_TURN_COS2 = 0.5;
+
+static void prediction_process(struct slot_filter *base, const struct timeval *time);
+
+bool prediction_event_dispatcher_create(struct prediction_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		int lead_ms, const struct input_absinfo *x_range, const struct input_absinfo *y_range)
+{
+	assert(self != NULL);
+	if (lead_ms < 0 || lead_ms > PREDICTION_MAX_LEAD_MS)
+	{
+		fprintf(stderr, "prediction_event_dispatcher_create: prediction interval not within 0 .. %d ms\n", PREDICTION_MAX_LEAD_MS);
+		return false;
+	}
+
+	if (!slot_filter_init(&self->base, next, slot_count, prediction_process, NULL))
+		return false;
+
+	self->lead_us = (int64_t)lead_ms * 1000;
+
+	self->clamp_x = x_range != NULL && x_range->minimum < x_range->maximum;
+	if (self->clamp_x)
+		self->x_range = *x_range;
+
+	self->clamp_y = y_range != NULL && y_range->minimum < y_range->maximum;
+	if (self->clamp_y)
+		self->y_range = *y_range;
+
+	memset(self->history, 0, sizeof(self->history));
+
+	return true;
+}
+
+static const struct prediction_sample *get_sample(const struct prediction_history *h, unsigned age)
+{
+	assert(age < h->count);
+	return &h->samples[(h->head - 1 - age) & (PREDICTION_HISTORY_SIZE - 1)];
+}
+
+static void push_sample(struct prediction_history *h, int64_t time_us, int x, int y)
+{
+	struct prediction_sample *s = &h->samples[h->head];
+	s->time_us = time_us;
+	s->x = x;
+	s->y = y;
+
+	h->head = (h->head + 1) & (PREDICTION_HISTORY_SIZE - 1);
+	if (h->count < PREDICTION_HISTORY_SIZE)
+		++h->count;
+}
+
+static bool is_sharp_turn(const struct prediction_history *h)
+{
+	const struct prediction_sample *s0 = get_sample(h, 0);
+	const struct prediction_sample *s1 = get_sample(h, 1);
+	const struct prediction_sample *s2 = get_sample(h, 2);
+
+	const double x1 = s0->x - s1->x, y1 = s0->y - s1->y;
+	const double x0 = s1->x - s2->x, y0 = s1->y - s2->y;
+
+	const double dot = x0*x1 + y0*y1;
+	if (dot <= 0)
+		return true;
+
+	return dot*dot < PREDICTION_MIN_TURN_COS2 * (x0*x0 + y0*y0) * (x1*x1 + y1*y1);
+}
+
+static int clamp(int64_t value, bool enabled, const struct input_absinfo *range)
+{
+	const int64_t minimum = enabled ? range->minimum : INT_MIN;
+	const int64_t maximum = enabled ? range->maximum : INT_MAX;
+	if (value < minimum)
+		return minimum;
+	if (value > maximum)
+		return maximum;
+	return value;
+}
+
+/**
+ * Extrapolate \a newest by \a k times the step from \a oldest.
+ */
+static int predict(int newest, int oldest, double k, bool enabled, const struct input_absinfo *range)
+{
+	// a short sample span makes k large, the step has to fit an int before it is converted
+	double step = ((double)newest - oldest) * k;
+	if (step > INT_MAX)
+		step = INT_MAX;
+	else if (step < INT_MIN)
+		step = INT_MIN;
+
+	return clamp((int64_t)newest + (int)step, enabled, range);
+}
+
+static void prediction_process(struct slot_filter *base, const struct timeval *time)
+{
+	assert(base != NULL);
+	struct prediction_event_dispatcher* const self = (struct prediction_event_dispatcher*)base;
+
+	const int64_t now = (int64_t)time->tv_sec * 1000000 + time->tv_usec;
+
+	for (int i = 0; i < base->slot_count; ++i)
+	{
+		struct slot_filter_contact *c = &base->contacts[i];
+		struct prediction_history *h = &self->history[i];
+
+		// touch-down and touch-up start from scratch
+		if (c->tracking_id < 0 || c->began)
+			h->count = 0;
+
+		// contact at rest: report where it really is
+		if (c->tracking_id < 0 || !c->moved)
+			continue;
+
+		if (h->count > 0 && now - get_sample(h, 0)->time_us > PREDICTION_MAX_GAP_US)
+			h->count = 0;
+
+		push_sample(h, now, c->in_x, c->in_y);
+		if (h->count < PREDICTION_MIN_SAMPLES)
+			continue;
+
+		if (is_sharp_turn(h))
+		{
+			h->count = 1;
+			continue;
+		}
+
+		const struct prediction_sample *newest = get_sample(h, 0);
+		const struct prediction_sample *oldest = get_sample(h, h->count - 1);
+		const int64_t dt = newest->time_us - oldest->time_us;
+		if (dt <= 0)
+			continue;
+
+		const double k = (double)self->lead_us / dt;
+		c->out_x = predict(newest->x, oldest->x, k, self->clamp_x, &self->x_range);
+		c->out_y = predict(newest->y, oldest->y, k, self->clamp_y, &self->y_range);
+	}
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef PREDICTION_EVENT_DISPATCHER_H
+#define PREDICTION_EVENT_DISPATCHER_H
+
+#include <stdint.h>
+
+#include "slot_filter.h"
+
+/**
+ * \brief Number of samples kept per slot, must be a power of two.
+ */
+#define PREDICTION_HISTORY_SIZE 4
+
+/**
+ * \brief Longest prediction interval, well past where a linear model still holds.
+ */
+#define PREDICTION_MAX_LEAD_MS 100
+
+struct prediction_sample
+{
+	int64_t time_us;
+	int x, y;
+};
+
+struct prediction_history
+{
+	struct prediction_sample samples[PREDICTION_HISTORY_SIZE];
+	unsigned head; // index the next sample goes to
+	unsigned count;
+};
+
+/**
+ * \brief Pipeline stage that reports contact positions extrapolated \a lead_ms into the future.
+ *
+ * A linear model fitted to the last few samples of each slot is used.
+ * Prediction is off for the first frames after touch-down, on touch-up,
+ * after a sharp change of direction and while the contact is at rest.
+ * The single-touch pointer (ABS_X/ABS_Y) is left alone.
+ */
+struct prediction_event_dispatcher
+{
+	struct slot_filter base;
+	int64_t lead_us;
+	bool clamp_x, clamp_y;
+	struct input_absinfo x_range, y_range;
+	struct prediction_history history[SLOT_FILTER_MAX_SLOTS];
+};
+
+/**
+ * \brief Create the prediction stage in front of \a next for \a slot_count MT slots.
+ *
+ * Predicted positions are clamped to \a x_range and \a y_range, either of which may be NULL.
+ */
+bool prediction_event_dispatcher_create(struct prediction_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		int lead_ms, const struct input_absinfo *x_range, const struct input_absinfo *y_range);
+
+#endif // PREDICTION_EVENT_DISPATCHER_H
@@ -0,0 +1,236 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+// syscall() is not part of POSIX
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <assert.h>
+
+#include "profiler.h"
+
+struct profiler_counter
+{
+	uint32_t type;
+	uint64_t config;
+	const char *name;
+};
+
+static const struct profiler_counter HARDWARE_COUNTERS[] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses" }
+};
+
+static const struct profiler_counter SOFTWARE_COUNTERS[] =
+{
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock-ns" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu-migrations" }
+};
+
+static const char *STAGE_NAMES[PROFILER_STAGE_COUNT] = { "poll", "read+mtdev", "dispatch" };
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void close_counters(struct profiler *self)
+{
+	for (int i = 1; i < self->counter_count; ++i)
+	{
+		if (self->fds[i] >= 0)
+			close(self->fds[i]);
+		self->fds[i] = -1;
+	}
+	self->group_fd = -1;
+	self->counter_count = 1;
+	self->switch_counter = 0;
+}
+
+static int open_counter(const struct profiler_counter *counter, bool exclude_kernel, int group_fd, uint64_t read_format)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counter->type;
+	attr.config = counter->config;
+	attr.read_format = read_format;
+	attr.exclude_kernel = exclude_kernel;
+	attr.exclude_hv = 1;
+
+	// this thread on any CPU
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static bool open_counters(struct profiler *self, const struct profiler_counter *counters, int count, bool exclude_kernel)
+{
+	assert(count < PROFILER_MAX_COUNTERS);
+	for (int i = 0; i < count; ++i)
+	{
+		const int fd = open_counter(&counters[i], exclude_kernel, self->group_fd, PERF_FORMAT_GROUP);
+		if (fd < 0)
+		{
+			close_counters(self);
+			return false;
+		}
+
+		if (i == 0)
+			self->group_fd = fd;
+		self->fds[self->counter_count] = fd;
+		self->names[self->counter_count] = counters[i].name;
+		++self->counter_count;
+	}
+	self->user_only = exclude_kernel;
+	return true;
+}
+
+static void open_switch_counter(struct profiler *self)
+{
+	assert(self->counter_count < PROFILER_MAX_COUNTERS);
+	static const struct profiler_counter SWITCHES = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx-switches" };
+
+	// excluding the kernel would leave nothing to count
+	const int fd = open_counter(&SWITCHES, false, -1, 0);
+	if (fd < 0)
+		return;
+
+	self->switch_counter = self->counter_count;
+	self->fds[self->counter_count] = fd;
+	self->names[self->counter_count] = SWITCHES.name;
+	++self->counter_count;
+}
+
+static void read_counters(const struct profiler *self, uint64_t *values)
+{
+	values[0] = clock_ns(CLOCK_MONOTONIC);
+
+	if (self->group_fd >= 0)
+	{
+		uint64_t buf[1 + PROFILER_MAX_COUNTERS];
+		if (read(self->group_fd, buf, sizeof(buf)) > 0)
+		{
+			for (uint64_t i = 0; i < buf[0] && i + 1 < PROFILER_MAX_COUNTERS; ++i)
+				values[i + 1] = buf[i + 1];
+		}
+	}
+	else
+		values[1] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+	if (self->switch_counter > 0)
+	{
+		uint64_t switches;
+		if (read(self->fds[self->switch_counter], &switches, sizeof(switches)) == sizeof(switches))
+			values[self->switch_counter] = switches;
+	}
+}
+
+bool profiler_create(struct profiler *self)
+{
+	assert(self != NULL);
+	memset(self, 0, sizeof(*self));
+	self->group_fd = -1;
+	for (int i = 0; i < PROFILER_MAX_COUNTERS; ++i)
+		self->fds[i] = -1;
+
+	self->names[0] = "wall-ns";
+	self->counter_count = 1;
+
+	const int hw_count = sizeof(HARDWARE_COUNTERS)/sizeof(HARDWARE_COUNTERS[0]);
+	const int sw_count = sizeof(SOFTWARE_COUNTERS)/sizeof(SOFTWARE_COUNTERS[0]);
+	if (!open_counters(self, HARDWARE_COUNTERS, hw_count, false)
+		&& !open_counters(self, HARDWARE_COUNTERS, hw_count, true)
+		&& !open_counters(self, SOFTWARE_COUNTERS, sw_count, false)
+		&& !open_counters(self, SOFTWARE_COUNTERS, sw_count, true))
+	{
+		fprintf(stderr, "profiler: perf events not available, using the thread CPU clock\n");
+		self->names[1] = "cpu-ns";
+		self->counter_count = 2;
+	}
+	open_switch_counter(self);
+
+	self->stage = PROFILER_STAGE_MTDEV;
+	read_counters(self, self->last);
+	return true;
+}
+
+void profiler_enter(struct profiler *self, enum profiler_stage stage)
+{
+	assert(self != NULL);
+	uint64_t now[PROFILER_MAX_COUNTERS];
+	read_counters(self, now);
+
+	uint64_t *totals = self->totals[self->stage];
+	for (int i = 0; i < self->counter_count; ++i)
+	{
+		totals[i] += now[i] - self->last[i];
+		self->last[i] = now[i];
+	}
+
+	++self->switches[stage];
+	self->stage = stage;
+}
+
+void profiler_print(const struct profiler *self, FILE *f)
+{
+	assert(self != NULL);
+	const double frames = self->frames > 0 ? (double)self->frames : 1.0;
+
+	fprintf(f, "profile: %llu frames, counts per frame%s\n", (unsigned long long)self->frames,
+			self->user_only ? ", perf counters in user space only" : "");
+	if (self->switch_counter == 0)
+		fprintf(f, "ctx-switches: not available, counting them needs kernel events\n");
+	fprintf(f, "%-12s %14s", "stage", "entries");
+	for (int i = 0; i < self->counter_count; ++i)
+		fprintf(f, " %14s", self->names[i]);
+	fputc('\n', f);
+
+	for (int s = 0; s < PROFILER_STAGE_COUNT; ++s)
+	{
+		fprintf(f, "%-12s %14.1f", STAGE_NAMES[s], self->switches[s] / frames);
+		for (int i = 0; i < self->counter_count; ++i)
+			fprintf(f, " %14.1f", self->totals[s][i] / frames);
+		fputc('\n', f);
+	}
+}
+
+void profiler_destroy(struct profiler *self)
+{
+	assert(self != NULL);
+	close_counters(self);
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum profiler_stage
+{
+	PROFILER_STAGE_POLL, // waiting for input
+	PROFILER_STAGE_MTDEV, // reading the device and converting with mtdev
+	PROFILER_STAGE_DISPATCH, // passing frames to the event dispatcher
+	PROFILER_STAGE_COUNT
+};
+
+// wall clock plus up to 4 perf counters
+#define PROFILER_MAX_COUNTERS 5
+
+/**
+ * \brief Attributes CPU counters to the stages of translate_loop().
+ *
+ * A group of perf_event_open() counters (cycles, instructions, cache
+ * misses) is read at every stage switch. If the PMU is not available
+ * software perf events are used and if perf events are not available at
+ * all the thread CPU clock is used. Where kernel counts are not allowed the
+ * counters are limited to user space. Context switches happen in the
+ * kernel, so they are counted by a separate counter that never excludes it
+ * and are reported as not available when that is not allowed.
+ */
+struct profiler
+{
+	int group_fd;
+	int fds[PROFILER_MAX_COUNTERS];
+	int counter_count;
+	const char *names[PROFILER_MAX_COUNTERS];
+	int switch_counter; // index of the context switch counter, 0 when not available
+	bool user_only; // the group counts user space only
+
+	enum profiler_stage stage;
+	uint64_t last[PROFILER_MAX_COUNTERS];
+	uint64_t totals[PROFILER_STAGE_COUNT][PROFILER_MAX_COUNTERS];
+	uint64_t switches[PROFILER_STAGE_COUNT];
+	uint64_t frames;
+};
+
+bool profiler_create(struct profiler *self);
+
+/**
+ * \brief Attribute the counts since the last switch to the current stage and enter \a stage.
+ */
+void profiler_enter(struct profiler *self, enum profiler_stage stage);
+
+static inline void profiler_count_frame(struct profiler *self)
+{
+	++self->frames;
+}
+
+/**
+ * \brief Print the counts per frame and stage.
+ */
+void profiler_print(const struct profiler *self, FILE *f);
+
+void profiler_destroy(struct profiler *self);
+
+#endif // PROFILER_H
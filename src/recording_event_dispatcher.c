@@ -0,0 +1,69 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "recording_event_dispatcher.h"
+
+static bool recording_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count);
+static void recording_event_dispatcher_destroy(struct event_dispatcher *base);
+
+bool recording_event_dispatcher_create(struct recording_event_dispatcher *self, struct event_dispatcher *next,
+		struct flight_recorder *recorder)
+{
+	assert(self != NULL);
+	assert(next != NULL);
+	assert(recorder != NULL);
+	self->base.dispatch = recording_event_dispatcher_dispatch;
+	self->base.destroy = recording_event_dispatcher_destroy;
+
+	self->next = next;
+	self->recorder = recorder;
+
+	return true;
+}
+
+static bool recording_event_dispatcher_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	assert(base != NULL);
+	struct recording_event_dispatcher* const self = (struct recording_event_dispatcher*)base;
+
+	// the output is a single device, even with several panels merged into it
+	flight_recorder_record_output(self->recorder, 0, events, count);
+	return self->next->dispatch(self->next, events, count);
+}
+
+static void recording_event_dispatcher_destroy(struct event_dispatcher *base)
+{
+	assert(base != NULL);
+	struct recording_event_dispatcher* const self = (struct recording_event_dispatcher*)base;
+
+	self->next->destroy(self->next);
+	free(self->next);
+}
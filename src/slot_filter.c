@@ -0,0 +1,387 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <assert.h>
+
+#include "slot_filter.h"
+
+static bool slot_filter_dispatch(struct event_dispatcher *base, const struct input_event *events, int count);
+static void slot_filter_destroy(struct event_dispatcher *base);
+
+static void reset_contact(struct slot_filter_contact *c)
+{
+	c->tracking_id = -1;
+	c->in_x = c->in_y = 0;
+	c->out_x = c->out_y = 0;
+	c->sent_x = c->sent_y = INT_MIN;
+	c->moved = c->began = c->ended = false;
+}
+
+bool slot_filter_init(struct slot_filter *self, struct event_dispatcher *next, int slot_count,
+		void (*process)(struct slot_filter *self, const struct timeval *time),
+		void (*cleanup)(struct slot_filter *self))
+{
+	assert(self != NULL);
+	assert(next != NULL);
+	assert(process != NULL);
+	if (slot_count < 1 || slot_count > SLOT_FILTER_MAX_SLOTS)
+	{
+		fprintf(stderr, "slot_filter_init: can't track %d slots, at most %d\n", slot_count, SLOT_FILTER_MAX_SLOTS);
+		return false;
+	}
+	self->base.dispatch = slot_filter_dispatch;
+	self->base.destroy = slot_filter_destroy;
+
+	self->next = next;
+	self->process = process;
+	self->cleanup = cleanup;
+
+	self->slot_count = slot_count;
+	self->slot = 0;
+	self->out_slot = 0;
+	self->touch = false;
+	self->has_pointer = false;
+	for (int i = 0; i <= SLOT_FILTER_MAX_SLOTS; ++i)
+		reset_contact(&self->contacts[i]);
+
+	self->frame_count = 0;
+
+	self->timed = false;
+	memset(&self->stats, 0, sizeof(self->stats));
+	return true;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static struct slot_filter_contact *get_contact(struct slot_filter *self, int slot)
+{
+	return (slot >= 0 && slot < self->slot_count) ? &self->contacts[slot] : NULL;
+}
+
+static void track_event(struct slot_filter *self, const struct input_event *ev)
+{
+	struct slot_filter_contact *c = get_contact(self, self->slot);
+	struct slot_filter_contact *pointer = &self->contacts[SLOT_FILTER_POINTER];
+
+	if (ev->type == EV_ABS)
+	{
+		switch (ev->code)
+		{
+		case ABS_MT_SLOT:
+			self->slot = ev->value;
+			break;
+		case ABS_MT_TRACKING_ID:
+			if (!c)
+				break;
+			if (ev->value < 0)
+			{
+				if (c->tracking_id >= 0)
+					c->ended = true;
+				c->tracking_id = -1;
+			}
+			else if (ev->value != c->tracking_id)
+			{
+				c->tracking_id = ev->value;
+				c->began = true;
+				c->sent_x = c->sent_y = INT_MIN;
+			}
+			break;
+		case ABS_MT_POSITION_X:
+			if (c)
+			{
+				c->in_x = ev->value;
+				c->moved = true;
+			}
+			break;
+		case ABS_MT_POSITION_Y:
+			if (c)
+			{
+				c->in_y = ev->value;
+				c->moved = true;
+			}
+			break;
+		case ABS_X:
+			self->has_pointer = true;
+			pointer->in_x = ev->value;
+			pointer->moved = true;
+			break;
+		case ABS_Y:
+			self->has_pointer = true;
+			pointer->in_y = ev->value;
+			pointer->moved = true;
+			break;
+		}
+	}
+	else if (ev->type == EV_KEY && ev->code == BTN_TOUCH)
+		self->touch = ev->value != 0;
+}
+
+/**
+ * Start or end the pointer pseudo contact once the whole frame is tracked;
+ * BTN_TOUCH usually comes ahead of the ABS_X/ABS_Y of the same frame.
+ */
+static void update_pointer(struct slot_filter *self)
+{
+	struct slot_filter_contact *pointer = &self->contacts[SLOT_FILTER_POINTER];
+	const bool down = self->touch && self->has_pointer;
+
+	if (down && pointer->tracking_id < 0)
+	{
+		pointer->tracking_id = 0;
+		pointer->began = true;
+		pointer->sent_x = pointer->sent_y = INT_MIN;
+	}
+	else if (!down && pointer->tracking_id >= 0)
+	{
+		pointer->tracking_id = -1;
+		pointer->ended = true;
+	}
+}
+
+/**
+ * Set the value of a position event; returns false if the event can be
+ * dropped because the value was already sent.
+ */
+static bool rewrite_value(struct input_event *ev, int out, int *sent)
+{
+	ev->value = out;
+	if (out == *sent)
+		return false;
+
+	*sent = out;
+	return true;
+}
+
+static void append_event(struct input_event *out, int *n, const struct timeval *time, uint16_t type, uint16_t code, int32_t value)
+{
+	struct input_event *ev = &out[(*n)++];
+	ev->time = *time;
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static void append_position(struct input_event *out, int *n, const struct timeval *time,
+		struct slot_filter_contact *c, uint16_t code_x, uint16_t code_y)
+{
+	if (c->out_x != c->sent_x)
+	{
+		append_event(out, n, time, EV_ABS, code_x, c->out_x);
+		c->sent_x = c->out_x;
+	}
+	if (c->out_y != c->sent_y)
+	{
+		append_event(out, n, time, EV_ABS, code_y, c->out_y);
+		c->sent_y = c->out_y;
+	}
+}
+
+static bool flush_frame(struct slot_filter *self, const struct timeval *time, bool complete)
+{
+	const uint64_t begin_ns = self->timed ? now_ns() : 0;
+	self->stats.events_in += self->frame_count;
+	if (complete)
+		++self->stats.frames_in;
+
+	const int start_slot = self->slot;
+	for (int i = 0; i < self->frame_count; ++i)
+		track_event(self, &self->frame[i]);
+	update_pointer(self);
+
+	for (int i = 0; i <= self->slot_count; ++i)
+	{
+		struct slot_filter_contact *c = &self->contacts[slot_filter_index(self, i)];
+		c->out_x = c->in_x;
+		c->out_y = c->in_y;
+	}
+
+	self->process(self, time);
+
+	struct input_event *out = self->out;
+	int n = 0;
+	bool significant = false;
+	bool has_syn_report = false;
+	int slot = start_slot;
+	for (int i = 0; i < self->frame_count; ++i)
+	{
+		struct input_event ev = self->frame[i];
+
+		if (ev.type == EV_SYN && ev.code == SYN_REPORT)
+		{
+			has_syn_report = true;
+			continue;
+		}
+
+		// a timestamp alone does not make a frame worth sending
+		if (ev.type == EV_MSC && ev.code == MSC_TIMESTAMP)
+		{
+			out[n++] = ev;
+			continue;
+		}
+
+		if (ev.type == EV_ABS)
+		{
+			if (ev.code == ABS_MT_SLOT)
+			{
+				// emitted lazily with the next event of the slot
+				slot = ev.value;
+				continue;
+			}
+			else if (ev.code >= ABS_MT_TOUCH_MAJOR && ev.code <= ABS_MAX)
+			{
+				struct slot_filter_contact *c = get_contact(self, slot);
+				if (c && ev.code == ABS_MT_POSITION_X && !rewrite_value(&ev, c->out_x, &c->sent_x))
+					continue;
+				if (c && ev.code == ABS_MT_POSITION_Y && !rewrite_value(&ev, c->out_y, &c->sent_y))
+					continue;
+
+				if (slot != self->out_slot)
+				{
+					append_event(out, &n, &ev.time, EV_ABS, ABS_MT_SLOT, slot);
+					self->out_slot = slot;
+				}
+
+				// the last position sent may have been a rewritten one, lift where the contact really is
+				if (c && ev.code == ABS_MT_TRACKING_ID && ev.value < 0 && c->ended && c->tracking_id < 0)
+					append_position(out, &n, &ev.time, c, ABS_MT_POSITION_X, ABS_MT_POSITION_Y);
+			}
+			else if (ev.code == ABS_X || ev.code == ABS_Y)
+			{
+				struct slot_filter_contact *pointer = &self->contacts[SLOT_FILTER_POINTER];
+				if (ev.code == ABS_X && !rewrite_value(&ev, pointer->out_x, &pointer->sent_x))
+					continue;
+				if (ev.code == ABS_Y && !rewrite_value(&ev, pointer->out_y, &pointer->sent_y))
+					continue;
+			}
+		}
+		else if (ev.type == EV_KEY && ev.code == BTN_TOUCH && !ev.value)
+		{
+			struct slot_filter_contact *pointer = &self->contacts[SLOT_FILTER_POINTER];
+			if (pointer->ended && pointer->tracking_id < 0)
+				append_position(out, &n, &ev.time, pointer, ABS_X, ABS_Y);
+		}
+
+		out[n++] = ev;
+		significant = true;
+	}
+
+	// positions that changed without a position event in the frame
+	for (int i = 0; i <= self->slot_count; ++i)
+	{
+		struct slot_filter_contact *c = &self->contacts[slot_filter_index(self, i)];
+		if (c->tracking_id < 0 || (c->out_x == c->sent_x && c->out_y == c->sent_y))
+			continue;
+
+		const bool is_pointer = i == self->slot_count;
+		if (!is_pointer && i != self->out_slot)
+		{
+			append_event(out, &n, time, EV_ABS, ABS_MT_SLOT, i);
+			self->out_slot = i;
+		}
+		if (is_pointer)
+			append_position(out, &n, time, c, ABS_X, ABS_Y);
+		else
+			append_position(out, &n, time, c, ABS_MT_POSITION_X, ABS_MT_POSITION_Y);
+		significant = true;
+	}
+
+	if (has_syn_report)
+		append_event(out, &n, time, EV_SYN, SYN_REPORT, 0);
+
+	assert(n <= SLOT_FILTER_MAX_OUT_EVENTS);
+
+	for (int i = 0; i <= self->slot_count; ++i)
+	{
+		struct slot_filter_contact *c = &self->contacts[slot_filter_index(self, i)];
+		c->moved = c->began = c->ended = false;
+	}
+	self->frame_count = 0;
+
+	// a frame carrying nothing but SYN_REPORT is of no use to anyone
+	const bool forward = !complete || significant;
+	if (forward)
+	{
+		self->stats.events_out += n;
+		if (complete)
+			++self->stats.frames_out;
+	}
+	if (self->timed)
+		self->stats.ns += now_ns() - begin_ns;
+
+	return !forward || self->next->dispatch(self->next, out, n);
+}
+
+static bool slot_filter_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	assert(base != NULL);
+	struct slot_filter* const self = (struct slot_filter*)base;
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (self->frame_count == SLOT_FILTER_MAX_EVENTS)
+		{
+			// frame too long, pass on what we have so far
+			if (!flush_frame(self, &self->frame[self->frame_count - 1].time, false))
+				return false;
+		}
+
+		self->frame[self->frame_count++] = events[i];
+
+		if (events[i].type == EV_SYN && events[i].code == SYN_REPORT)
+		{
+			if (!flush_frame(self, &events[i].time, true))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void slot_filter_destroy(struct event_dispatcher *base)
+{
+	assert(base != NULL);
+	struct slot_filter* const self = (struct slot_filter*)base;
+
+	if (self->cleanup)
+		self->cleanup(self);
+
+	self->next->destroy(self->next);
+	free(self->next);
+}
@@ -0,0 +1,138 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef SLOT_FILTER_H
+#define SLOT_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <linux/input.h>
+
+#include "event_dispatcher.h"
+
+/**
+ * \brief Maximum number of MT slots a slot filter tracks, as many as the panel merger produces.
+ */
+#define SLOT_FILTER_MAX_SLOTS 256
+
+/**
+ * \brief Index of the pseudo contact that tracks the single-touch ABS_X/ABS_Y pointer.
+ */
+#define SLOT_FILTER_POINTER SLOT_FILTER_MAX_SLOTS
+
+/**
+ * \brief Maximum number of events buffered for a single frame.
+ */
+#define SLOT_FILTER_MAX_EVENTS 512
+
+// at most one ABS_MT_SLOT ahead of the rewritten frame, a slot switch and
+// both axes for every appended or lifted contact and the closing SYN_REPORT
+#define SLOT_FILTER_MAX_OUT_EVENTS (SLOT_FILTER_MAX_EVENTS + 1 + 3*(SLOT_FILTER_MAX_SLOTS + 1) + 1)
+
+struct slot_filter_contact
+{
+	int tracking_id; // -1 when the slot is not in contact
+	int in_x, in_y; // most recent position reported by the input
+	int out_x, out_y; // position to report for the current frame
+	int sent_x, sent_y; // position last sent to the next dispatcher
+	bool moved; // in_x or in_y changed in the current frame
+	bool began; // contact started in the current frame
+	bool ended; // contact ended in the current frame
+};
+
+/**
+ * \brief Traffic through a slot filter, \a ns is only collected when timing is enabled.
+ */
+struct slot_filter_stats
+{
+	uint64_t frames_in, frames_out;
+	uint64_t events_in, events_out;
+	uint64_t ns; // time spent in the filter itself, the next dispatcher excluded
+};
+
+/**
+ * \brief Common base of the pipeline stages that rewrite contact positions.
+ *
+ * The filter buffers mtdev output up to SYN_REPORT, keeps per-slot contact
+ * state and then calls \a process which sets out_x/out_y of each contact
+ * (they are preset to in_x/in_y). The frame is then rewritten: position
+ * events carry the new values, values that did not change since they were
+ * last sent are dropped, positions that changed without a matching event
+ * are appended, ABS_MT_SLOT is emitted only where needed and frames left
+ * with nothing but SYN_REPORT (and MSC_TIMESTAMP) are not forwarded at all.
+ * A lifted contact gets its out_x/out_y (preset to where it really was)
+ * sent right before its ABS_MT_TRACKING_ID -1 or BTN_TOUCH 0.
+ *
+ * The pointer pseudo contact is only tracked once the input reported
+ * ABS_X or ABS_Y, so that BTN_TOUCH alone does not make up a position.
+ *
+ * The filter owns \a next and destroys it in its own destroy.
+ */
+struct slot_filter
+{
+	struct event_dispatcher base;
+	struct event_dispatcher *next;
+
+	void (*process)(struct slot_filter *self, const struct timeval *time);
+	void (*cleanup)(struct slot_filter *self);
+
+	int slot_count; // slots tracked, events for higher slots are passed through untouched
+	int slot; // current slot of the input stream
+	int out_slot; // current slot as seen by the next dispatcher
+	bool touch; // BTN_TOUCH state of the input stream
+	bool has_pointer; // the input reports ABS_X/ABS_Y
+	struct slot_filter_contact contacts[SLOT_FILTER_MAX_SLOTS + 1];
+
+	bool timed;
+	struct slot_filter_stats stats;
+
+	int frame_count;
+	struct input_event frame[SLOT_FILTER_MAX_EVENTS];
+	struct input_event out[SLOT_FILTER_MAX_OUT_EVENTS];
+};
+
+/**
+ * \brief Initialize the base part of a slot filter tracking \a slot_count slots.
+ *
+ * Meant to be called from the create function of a concrete stage. \a cleanup may be NULL.
+ * Fails if \a slot_count is above SLOT_FILTER_MAX_SLOTS.
+ */
+bool slot_filter_init(struct slot_filter *self, struct event_dispatcher *next, int slot_count,
+		void (*process)(struct slot_filter *self, const struct timeval *time),
+		void (*cleanup)(struct slot_filter *self));
+
+/**
+ * \brief Index into \a contacts of the \a i-th of the slot_count + 1 tracked contacts, the pointer is the last one.
+ */
+static inline int slot_filter_index(const struct slot_filter *self, int i)
+{
+	return i < self->slot_count ? i : SLOT_FILTER_POINTER;
+}
+
+#endif // SLOT_FILTER_H
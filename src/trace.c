@@ -0,0 +1,121 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "trace.h"
+
+#ifdef HAVE_SYS_SDT_H
+	#define TRACE_SEMAPHORE(name) volatile unsigned short mt_translator_##name##_semaphore __attribute__((section(".probes"))) = 0
+
+	TRACE_SEMAPHORE(frame_begin);
+	TRACE_SEMAPHORE(frame_end);
+	TRACE_SEMAPHORE(mtdev_begin);
+	TRACE_SEMAPHORE(mtdev_end);
+	TRACE_SEMAPHORE(dispatch_begin);
+	TRACE_SEMAPHORE(dispatch_end);
+#endif
+
+static const size_t TRACE_BUFFER_SIZE = 1 << 20;
+
+static void begin_event(struct trace_writer *self)
+{
+	fputs(self->first ? "\n" : ",\n", self->file);
+	self->first = false;
+}
+
+static void thread_name(struct trace_writer *self, int tid, const char *name, int input)
+{
+	begin_event(self);
+	fprintf(self->file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+			self->pid, tid, name, input);
+}
+
+bool trace_writer_create(struct trace_writer *self, const char *path, int input_count)
+{
+	assert(self != NULL);
+	self->first = true;
+	self->pid = (int)getpid();
+	self->file = fopen(path, "w");
+	if (!self->file)
+	{
+		perror("can't create trace file");
+		return false;
+	}
+
+	setvbuf(self->file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", self->file);
+
+	for (int i = 0; i < input_count; ++i)
+	{
+		thread_name(self, 2*i + 1, "frames of input", i);
+		thread_name(self, 2*i + 2, "stages of input", i);
+	}
+
+	return true;
+}
+
+uint64_t trace_writer_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void trace_writer_frame(struct trace_writer *self, int input, uint64_t begin_ns, uint64_t end_ns, int events, int contacts)
+{
+	assert(self != NULL);
+	begin_event(self);
+	fprintf(self->file, "{\"name\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+			"\"args\":{\"input\":%d,\"events\":%d,\"contacts\":%d}}",
+			begin_ns / 1000.0, (end_ns - begin_ns) / 1000.0, self->pid, 2*input + 1, input, events, contacts);
+}
+
+void trace_writer_stage(struct trace_writer *self, const char *name, int input, uint64_t begin_ns, uint64_t end_ns)
+{
+	assert(self != NULL);
+	begin_event(self);
+	fprintf(self->file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+			name, begin_ns / 1000.0, (end_ns - begin_ns) / 1000.0, self->pid, 2*input + 2);
+}
+
+void trace_writer_destroy(struct trace_writer *self)
+{
+	assert(self != NULL);
+	if (!self->file)
+		return;
+
+	fputs("\n]}\n", self->file);
+	if (fclose(self->file) != 0)
+		perror("can't write trace file");
+	self->file = NULL;
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+
+/*
+ * Static probes of the frame pipeline, provider "mt_translator":
+ *
+ *   frame_begin(input)                first event of a frame left mtdev
+ *   frame_end(input, contacts)        the frame was dispatched
+ *   mtdev_begin(input, count)         raw events are fed to mtdev, count is 0
+ *                                     where mtdev resumes after a dispatched frame
+ *   mtdev_end(input)                  right before a frame is dispatched and
+ *                                     when mtdev has nothing more
+ *   dispatch_begin(input, count)      entry of event_dispatcher->dispatch
+ *   dispatch_end(input, ok)           exit of event_dispatcher->dispatch
+ *
+ * They are USDT probes when sys/sdt.h is available (a nop until a tracer
+ * attaches) and expand to nothing otherwise. Each has a semaphore, so
+ * TRACE_PROBE_ENABLED() tells whether its arguments are worth computing.
+ */
+#ifdef HAVE_SYS_SDT_H
+	#define _SDT_HAS_SEMAPHORES 1
+	#include <sys/sdt.h>
+	#define TRACE_PROBE1(name, a) DTRACE_PROBE1(mt_translator, name, a)
+	#define TRACE_PROBE2(name, a, b) DTRACE_PROBE2(mt_translator, name, a, b)
+	#define TRACE_PROBE_ENABLED(name) (mt_translator_##name##_semaphore != 0)
+
+	// defined in trace.c, attached tracers count themselves in them
+	extern volatile unsigned short mt_translator_frame_begin_semaphore;
+	extern volatile unsigned short mt_translator_frame_end_semaphore;
+	extern volatile unsigned short mt_translator_mtdev_begin_semaphore;
+	extern volatile unsigned short mt_translator_mtdev_end_semaphore;
+	extern volatile unsigned short mt_translator_dispatch_begin_semaphore;
+	extern volatile unsigned short mt_translator_dispatch_end_semaphore;
+#else
+	#define TRACE_PROBE1(name, a) do {} while (0)
+	#define TRACE_PROBE2(name, a, b) do {} while (0)
+	#define TRACE_PROBE_ENABLED(name) false
+#endif
+
+/**
+ * \brief Writes spans as a Chrome trace-event JSON file, which Perfetto can load too.
+ *
+ * Timestamps are CLOCK_MONOTONIC. Frames of input N are on thread 2N+1,
+ * the stages on thread 2N+2.
+ */
+struct trace_writer
+{
+	FILE *file;
+	bool first;
+	int pid;
+};
+
+bool trace_writer_create(struct trace_writer *self, const char *path, int input_count);
+
+/**
+ * \brief Current time in the clock of the trace.
+ */
+uint64_t trace_writer_now_ns(void);
+
+void trace_writer_frame(struct trace_writer *self, int input, uint64_t begin_ns, uint64_t end_ns, int events, int contacts);
+
+void trace_writer_stage(struct trace_writer *self, const char *name, int input, uint64_t begin_ns, uint64_t end_ns);
+
+void trace_writer_destroy(struct trace_writer *self);
+
+#endif // TRACE_H
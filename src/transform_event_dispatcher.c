@@ -0,0 +1,227 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "transform_event_dispatcher.h"
+
+static const int TRANSFORM_FRACTION_BITS = 16;
+
+static void transform_process(struct slot_filter *base, const struct timeval *time);
+
+void transform_config_init(struct transform_config *config)
+{
+	assert(config != NULL);
+	static const double identity[6] = { 1, 0, 0, 0, 1, 0 };
+	memcpy(config->matrix, identity, sizeof(identity));
+	config->swap_axes = false;
+}
+
+bool transform_config_parse_matrix(struct transform_config *config, const char *s)
+{
+	assert(config != NULL);
+	double m[9];
+	int count = 0;
+	while (count < 9)
+	{
+		char *end;
+		m[count++] = strtod(s, &end);
+		if (end == s)
+			return false;
+
+		s = end;
+		if (*s == '\0')
+			break;
+		if (*s != ',')
+			return false;
+		++s;
+	}
+
+	if (*s != '\0')
+		return false;
+
+	if (count == 9 && (m[6] != 0 || m[7] != 0 || m[8] != 1))
+	{
+		fprintf(stderr, "transform_config_parse_matrix: not an affine transformation\n");
+		return false;
+	}
+	if (count != 6 && count != 9)
+		return false;
+
+	memcpy(config->matrix, m, sizeof(config->matrix));
+	return true;
+}
+
+static void swap_absinfo(struct input_absinfo *a, struct input_absinfo *b)
+{
+	struct input_absinfo tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+void transform_absinfo(const struct transform_config *config, struct input_absinfo *absinfo)
+{
+	assert(config != NULL);
+	assert(absinfo != NULL);
+
+	// the matrix works on normalized positions, only a swap changes the ranges
+	if (config->swap_axes)
+	{
+		swap_absinfo(&absinfo[ABS_X], &absinfo[ABS_Y]);
+		swap_absinfo(&absinfo[ABS_MT_POSITION_X], &absinfo[ABS_MT_POSITION_Y]);
+	}
+}
+
+static double range_width(const struct input_absinfo *a)
+{
+	return a->maximum > a->minimum ? a->maximum - a->minimum : 1;
+}
+
+static int64_t to_fixed(double value)
+{
+	const double scaled = value * (1 << TRANSFORM_FRACTION_BITS);
+	return (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+/**
+ * Fold normalization, axis swap, the matrix and scaling to the target range
+ * into a single affine transformation of the raw device coordinates.
+ */
+static void compute_coefficients(int64_t coeff[6], const struct transform_config *config,
+		const struct input_absinfo *x, const struct input_absinfo *y)
+{
+	// axes feeding the normalized x and y; the target ranges follow the swap
+	const struct input_absinfo *src_x = config->swap_axes ? y : x;
+	const struct input_absinfo *src_y = config->swap_axes ? x : y;
+
+	for (int row = 0; row < 2; ++row)
+	{
+		const double *m = &config->matrix[3*row];
+		const struct input_absinfo *target = row == 0 ? src_x : src_y;
+		const double width = target->maximum - target->minimum;
+
+		const double k_x = width * m[0] / range_width(src_x);
+		const double k_y = width * m[1] / range_width(src_y);
+		const double k_0 = target->minimum + width * m[2] - k_x * src_x->minimum - k_y * src_y->minimum;
+
+		coeff[3*row + 0] = to_fixed(config->swap_axes ? k_y : k_x);
+		coeff[3*row + 1] = to_fixed(config->swap_axes ? k_x : k_y);
+		coeff[3*row + 2] = to_fixed(k_0) + (1 << (TRANSFORM_FRACTION_BITS - 1)); // round to nearest
+	}
+}
+
+bool transform_event_dispatcher_create(struct transform_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		const struct transform_config *config, const struct input_absinfo *absinfo)
+{
+	assert(self != NULL);
+	assert(config != NULL);
+	assert(absinfo != NULL);
+
+	if (!slot_filter_init(&self->base, next, slot_count, transform_process, NULL))
+		return false;
+
+	struct input_absinfo target[ABS_CNT];
+	memcpy(target, absinfo, sizeof(target));
+	transform_absinfo(config, target);
+
+	compute_coefficients(self->mt_coeff, config, &absinfo[ABS_MT_POSITION_X], &absinfo[ABS_MT_POSITION_Y]);
+	self->mt_min_x = target[ABS_MT_POSITION_X].minimum;
+	self->mt_max_x = target[ABS_MT_POSITION_X].maximum;
+	self->mt_min_y = target[ABS_MT_POSITION_Y].minimum;
+	self->mt_max_y = target[ABS_MT_POSITION_Y].maximum;
+
+	compute_coefficients(self->pointer_coeff, config, &absinfo[ABS_X], &absinfo[ABS_Y]);
+	self->pointer_min_x = target[ABS_X].minimum;
+	self->pointer_max_x = target[ABS_X].maximum;
+	self->pointer_min_y = target[ABS_Y].minimum;
+	self->pointer_max_y = target[ABS_Y].maximum;
+
+	return true;
+}
+
+static inline int32_t clamp(int64_t value, int32_t min, int32_t max)
+{
+	return value < min ? min : (value > max ? max : (int32_t)value);
+}
+
+static void transform_batch(const int64_t coeff[6], int n,
+		const int32_t *restrict in_x, const int32_t *restrict in_y,
+		int32_t *restrict out_x, int32_t *restrict out_y,
+		int32_t min_x, int32_t max_x, int32_t min_y, int32_t max_y)
+{
+	const int64_t a = coeff[0], b = coeff[1], c = coeff[2];
+	const int64_t d = coeff[3], e = coeff[4], f = coeff[5];
+
+	// branch free so that the compiler can vectorize it
+	for (int i = 0; i < n; ++i)
+	{
+		const int64_t x = in_x[i], y = in_y[i];
+		out_x[i] = clamp((a*x + b*y + c) >> TRANSFORM_FRACTION_BITS, min_x, max_x);
+		out_y[i] = clamp((d*x + e*y + f) >> TRANSFORM_FRACTION_BITS, min_y, max_y);
+	}
+}
+
+static void transform_process(struct slot_filter *base, const struct timeval *time)
+{
+	assert(base != NULL);
+	(void)time; // unused
+	struct transform_event_dispatcher* const self = (struct transform_event_dispatcher*)base;
+
+	// nothing is sent for the slots above the highest one in use
+	int count = 0;
+	for (int i = 0; i < base->slot_count; ++i)
+	{
+		const struct slot_filter_contact *c = &base->contacts[i];
+		if (c->tracking_id >= 0 || c->ended || c->moved)
+			count = i + 1;
+	}
+
+	// every slot up to it is transformed; unchanged results are dropped by the slot filter
+	for (int i = 0; i < count; ++i)
+	{
+		self->in_x[i] = base->contacts[i].in_x;
+		self->in_y[i] = base->contacts[i].in_y;
+	}
+
+	transform_batch(self->mt_coeff, count, self->in_x, self->in_y, self->out_x, self->out_y,
+			self->mt_min_x, self->mt_max_x, self->mt_min_y, self->mt_max_y);
+
+	for (int i = 0; i < count; ++i)
+	{
+		base->contacts[i].out_x = self->out_x[i];
+		base->contacts[i].out_y = self->out_y[i];
+	}
+
+	struct slot_filter_contact *pointer = &base->contacts[SLOT_FILTER_POINTER];
+	transform_batch(self->pointer_coeff, 1, &pointer->in_x, &pointer->in_y, &pointer->out_x, &pointer->out_y,
+			self->pointer_min_x, self->pointer_max_x, self->pointer_min_y, self->pointer_max_y);
+}
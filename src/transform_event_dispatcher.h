@@ -0,0 +1,96 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+
+#ifndef TRANSFORM_EVENT_DISPATCHER_H
+#define TRANSFORM_EVENT_DISPATCHER_H
+
+#include <stdint.h>
+
+#include "slot_filter.h"
+
+/**
+ * \brief Calibration of the contact positions.
+ *
+ * Positions are normalized to [0, 1] using the axis ranges of the device,
+ * optionally swapped, multiplied by the affine matrix (the first two rows
+ * of a 3x3 matrix whose last row is 0 0 1) and scaled back to the target
+ * range, where they are clamped. This is the same convention as the
+ * coordinate transformation matrix of X.org and libinput.
+ */
+struct transform_config
+{
+	double matrix[6];
+	bool swap_axes;
+};
+
+/**
+ * \brief Set \a config to the identity transformation.
+ */
+void transform_config_init(struct transform_config *config);
+
+/**
+ * \brief Parse a comma separated list of 6 or 9 (the last row must be 0,0,1) matrix elements.
+ */
+bool transform_config_parse_matrix(struct transform_config *config, const char *s);
+
+/**
+ * \brief Adjust the axis ranges of a device (a table of ABS_CNT items) to the ranges of the transformed positions.
+ */
+void transform_absinfo(const struct transform_config *config, struct input_absinfo *absinfo);
+
+/**
+ * \brief Pipeline stage that applies a transform_config to all contacts of a frame.
+ *
+ * The matrix is turned into Q16.16 fixed point coefficients in device units
+ * and the slots up to the highest one in use are transformed at once from structure-of-arrays buffers.
+ * The single-touch pointer uses its own coefficients as the ABS_X/ABS_Y
+ * ranges may differ from the ABS_MT_POSITION_* ones.
+ */
+struct transform_event_dispatcher
+{
+	struct slot_filter base;
+
+	int64_t mt_coeff[6];
+	int32_t mt_min_x, mt_max_x, mt_min_y, mt_max_y;
+
+	int64_t pointer_coeff[6];
+	int32_t pointer_min_x, pointer_max_x, pointer_min_y, pointer_max_y;
+
+	int32_t in_x[SLOT_FILTER_MAX_SLOTS], in_y[SLOT_FILTER_MAX_SLOTS];
+	int32_t out_x[SLOT_FILTER_MAX_SLOTS], out_y[SLOT_FILTER_MAX_SLOTS];
+};
+
+/**
+ * \brief Create the transform stage in front of \a next for \a slot_count MT slots.
+ *
+ * \a absinfo is the ABS_CNT item table of the axis ranges of the input device.
+ */
+bool transform_event_dispatcher_create(struct transform_event_dispatcher *self, struct event_dispatcher *next, int slot_count,
+		const struct transform_config *config, const struct input_absinfo *absinfo);
+
+#endif // TRANSFORM_EVENT_DISPATCHER_H
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -51,29 +52,76 @@ static void uinput_event_dispatcher_destroy(struct event_dispatcher *base);
 
 static const char UINPUT_CONTROL_NODE[] = "/dev/input/uinput";
 
-static void set_details_for_capability_from_real_device(int uinput_ctl_fd, uint32_t capability, int real_input_dev_fd)
+// tracking IDs of mtdev and of the kernel are 16 bit
+static const int UINPUT_MAX_TRACKING_ID = 0xffff;
+
+static void set_code_bits(int uinput_ctl_fd, unsigned long request, const uint8_t *bits, unsigned max_code)
 {
-	// TODO
+	for (unsigned code = 0; code <= max_code; ++code)
+	{
+		if (device_profile_test_bit(bits, code))
+			ioctl(uinput_ctl_fd, request, code);
+	}
 }
 
-static bool set_event_bits_cb(int fd, uint32_t capability, void *user_data)
+static void set_abs(int uinput_ctl_fd, struct uinput_user_dev *uinput_dev, unsigned code, const struct input_absinfo *absinfo)
 {
-	(void)fd; // unused
-	int uinput_ctl_fd = *(int const*)user_data;
+	ioctl(uinput_ctl_fd, UI_SET_ABSBIT, code);
 
-	ioctl(uinput_ctl_fd, UI_SET_EVBIT, capability);
-	set_details_for_capability_from_real_device(uinput_ctl_fd, capability, fd);
+	// the ranges all go in with the device description
+	uinput_dev->absmin[code] = absinfo->minimum;
+	uinput_dev->absmax[code] = absinfo->maximum;
+	uinput_dev->absfuzz[code] = absinfo->fuzz;
+	uinput_dev->absflat[code] = absinfo->flat;
+}
 
-	return true;
+static void set_capabilities(int uinput_ctl_fd, struct uinput_user_dev *uinput_dev,
+		const struct device_profile *profile, const struct input_absinfo *absinfo, int slot_count)
+{
+	for (unsigned type = 0; type <= EV_MAX; ++type)
+	{
+		if (device_profile_test_bit(profile->ev_bits, type))
+			ioctl(uinput_ctl_fd, UI_SET_EVBIT, type);
+	}
+
+	set_code_bits(uinput_ctl_fd, UI_SET_KEYBIT, profile->key_bits, KEY_MAX);
+	set_code_bits(uinput_ctl_fd, UI_SET_RELBIT, profile->rel_bits, REL_MAX);
+	set_code_bits(uinput_ctl_fd, UI_SET_MSCBIT, profile->msc_bits, MSC_MAX);
+	set_code_bits(uinput_ctl_fd, UI_SET_PROPBIT, profile->prop_bits, INPUT_PROP_MAX);
+
+	for (unsigned code = 0; code <= ABS_MAX; ++code)
+	{
+		if (((profile->abs_bits >> code) & 1) && code != ABS_MT_SLOT && code != ABS_MT_TRACKING_ID)
+			set_abs(uinput_ctl_fd, uinput_dev, code, &absinfo[code]);
+	}
+
+	// the output is always type B, whether the input is type A or several merged panels;
+	// without these the kernel drops every event following ABS_MT_SLOT
+	ioctl(uinput_ctl_fd, UI_SET_EVBIT, EV_ABS);
+
+	struct input_absinfo slot;
+	memset(&slot, 0, sizeof(slot));
+	slot.maximum = slot_count - 1;
+	set_abs(uinput_ctl_fd, uinput_dev, ABS_MT_SLOT, &slot);
+
+	struct input_absinfo tracking_id = absinfo[ABS_MT_TRACKING_ID];
+	if (tracking_id.maximum <= tracking_id.minimum)
+	{
+		tracking_id.minimum = 0;
+		tracking_id.maximum = UINPUT_MAX_TRACKING_ID;
+	}
+	set_abs(uinput_ctl_fd, uinput_dev, ABS_MT_TRACKING_ID, &tracking_id);
 }
 
-bool uinput_event_dispatcher_create(struct uinput_event_dispatcher *self, int real_input_dev_fd)
+bool uinput_event_dispatcher_create(struct uinput_event_dispatcher *self, const struct device_profile *profile,
+		const struct input_absinfo *absinfo, int slot_count)
 {
 	assert(self != NULL);
 	self->base.dispatch = uinput_event_dispatcher_dispatch;
 	self->base.destroy = uinput_event_dispatcher_destroy;
 
 	self->uinput_dev_fd = -1;
+	self->metrics = NULL;
 
 	// TODO - http://thiemonge.org/getting-started-with-uinput
 	int uinput_ctl_fd = open(UINPUT_CONTROL_NODE, O_WRONLY | O_NONBLOCK);
@@ -83,16 +131,12 @@ bool uinput_event_dispatcher_create(struct uinput_event_dispatcher *self, int re
 		return false;
 	}
 
-	if (!foreach_capability(real_input_dev_fd, set_event_bits_cb, &uinput_ctl_fd))
-	{
-		return false;
-	}
-
 	struct uinput_user_dev uinput_dev;
 	memset(&uinput_dev, 0, sizeof(uinput_dev));
-	snprintf(uinput_dev.name, UINPUT_MAX_NAME_SIZE, "mt-translator check");
 
-	// TODO: axes ranges
+	set_capabilities(uinput_ctl_fd, &uinput_dev, profile, absinfo, slot_count);
+
+	snprintf(uinput_dev.name, UINPUT_MAX_NAME_SIZE, "mt-translator check");
 
 	// FIXME: copy from real device
 	uinput_dev.id.bustype = BUS_USB;
@@ -124,8 +168,7 @@ static bool uinput_event_dispatcher_dispatch(struct event_dispatcher *base, cons
 	assert(base != NULL);
 	struct uinput_event_dispatcher* const self = (struct uinput_event_dispatcher*)base;
 
-	const size_t N = sizeof(*events)*count;
-	if (write(self->uinput_dev_fd, events, N) != N)
+	if (!write_events(self->uinput_dev_fd, events, count, self->metrics, NULL))
 	{
 		perror("uinput_event_dispatcher_dispatch: write() failed!");
 		return false;
@@ -30,12 +30,25 @@
 
 #include "event_dispatcher.h"
 
+struct metrics_output;
+#include "device_profile.h"
+
 struct uinput_event_dispatcher
 {
 	struct event_dispatcher base;
 	int uinput_dev_fd;
+	struct metrics_output *metrics; // NULL when not collected
 };
 
-bool uinput_event_dispatcher_create(struct uinput_event_dispatcher *self, int real_input_dev_fd);
+/**
+ * \brief Create a uinput device with the capabilities of the device described by \a profile.
+ *
+ * The axis ranges are taken from \a absinfo (a table of ABS_CNT items) so
+ * that the new device can advertise the ranges of transformed positions.
+ * ABS_MT_SLOT (0 .. \a slot_count - 1) and ABS_MT_TRACKING_ID are always
+ * advertised since mtdev output is type B even for a type A device.
+ */
+bool uinput_event_dispatcher_create(struct uinput_event_dispatcher *self, const struct device_profile *profile,
+		const struct input_absinfo *absinfo, int slot_count);
 
 #endif // UINPUT_EVENT_DISPATCHER_H
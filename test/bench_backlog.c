@@ -0,0 +1,207 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+/*
+ * Latency of contact state changes behind a slow output, not run as a test.
+ *
+ *   bench_backlog     feeds two moving contacts every 100 us, one of them
+ *                     lifted and put down again every 50 frames, into a
+ *                     4 KiB pipe drained at one frame per 300 us, once
+ *                     through the fifo and once through the priority lane
+ */
+
+// F_SETPIPE_SZ
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <linux/input.h>
+
+#include "backlog_event_dispatcher.h"
+#include "metrics.h"
+
+static const int BENCH_FRAMES = 5000;
+static const int BENCH_TAP_PERIOD = 50;
+static const long BENCH_FEED_NS = 100000;
+static const long BENCH_DRAIN_NS = 300000;
+static const int BENCH_PIPE_SIZE = 4096;
+
+#define BENCH_SLOTS 2
+
+struct pipe_sink
+{
+	struct event_dispatcher base;
+	int fd;
+};
+
+static bool sink_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	const struct pipe_sink *self = (const struct pipe_sink*)base;
+	const char *data = (const char*)events;
+	size_t left = sizeof(events[0]) * count;
+	while (left > 0)
+	{
+		const ssize_t r = write(self->fd, data, left);
+		if (r <= 0)
+			return false;
+		data += r;
+		left -= r;
+	}
+	return true;
+}
+
+static void sink_destroy(struct event_dispatcher *base)
+{
+	(void)base; // unused
+}
+
+/**
+ * \brief What the consumer ends up with.
+ */
+struct consumer
+{
+	int fd;
+	int tracking_id[BENCH_SLOTS];
+	int x[BENCH_SLOTS];
+	long frames;
+};
+
+static void sleep_ns(long ns)
+{
+	const struct timespec ts = { 0, ns };
+	nanosleep(&ts, NULL);
+}
+
+static void *consume(void *arg)
+{
+	struct consumer *c = (struct consumer*)arg;
+	int slot = 0;
+	struct input_event ev;
+	while (read(c->fd, &ev, sizeof(ev)) == sizeof(ev))
+	{
+		if (ev.type == EV_ABS && ev.code == ABS_MT_SLOT)
+			slot = ev.value;
+		else if (ev.type == EV_ABS && ev.code == ABS_MT_TRACKING_ID && slot >= 0 && slot < BENCH_SLOTS)
+			c->tracking_id[slot] = ev.value;
+		else if (ev.type == EV_ABS && ev.code == ABS_MT_POSITION_X && slot >= 0 && slot < BENCH_SLOTS)
+			c->x[slot] = ev.value;
+		else if (ev.type == EV_SYN && ev.code == SYN_REPORT)
+		{
+			++c->frames;
+			sleep_ns(BENCH_DRAIN_NS);
+		}
+	}
+	return NULL;
+}
+
+static void set_event(struct input_event *ev, uint16_t type, uint16_t code, int32_t value)
+{
+	memset(ev, 0, sizeof(*ev));
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static int run(bool priority)
+{
+	int fds[2];
+	if (pipe(fds) != 0 || fcntl(fds[1], F_SETPIPE_SZ, BENCH_PIPE_SIZE) < 0)
+	{
+		perror("can't create pipe");
+		return 1;
+	}
+
+	struct consumer consumer;
+	memset(&consumer, 0, sizeof(consumer));
+	consumer.fd = fds[0];
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, consume, &consumer) != 0)
+		return 1;
+
+	struct pipe_sink *sink = (struct pipe_sink*)malloc(sizeof(*sink));
+	sink->base.dispatch = sink_dispatch;
+	sink->base.destroy = sink_destroy;
+	sink->fd = fds[1];
+
+	static struct backlog_event_dispatcher backlog;
+	if (!backlog_event_dispatcher_create(&backlog, &sink->base, fds[1], priority))
+		return 1;
+	static struct metrics_queue queue;
+	memset(&queue, 0, sizeof(queue));
+	backlog.metrics = &queue;
+	struct event_dispatcher *stage = &backlog.base;
+
+	uint64_t max_frames = 0, max_events = 0;
+	for (int f = 0; f < BENCH_FRAMES; ++f)
+	{
+		struct input_event frame[2 + 3*BENCH_SLOTS];
+		int n = 0;
+		for (int s = 0; s < BENCH_SLOTS; ++s)
+		{
+			set_event(&frame[n++], EV_ABS, ABS_MT_SLOT, s);
+			// slot 1 goes up and down every BENCH_TAP_PERIOD frames
+			const bool down = s == 0 || (f / BENCH_TAP_PERIOD) % 2 == 0;
+			if (f == 0 || (s == 1 && f % BENCH_TAP_PERIOD == 0))
+				set_event(&frame[n++], EV_ABS, ABS_MT_TRACKING_ID, down ? f + s : -1);
+			set_event(&frame[n++], EV_ABS, ABS_MT_POSITION_X, f + s*1000);
+		}
+		set_event(&frame[n++], EV_SYN, SYN_REPORT, 0);
+		if (!stage->dispatch(stage, frame, n))
+			return 1;
+
+		if (queue.frames > max_frames)
+			max_frames = queue.frames;
+		if (queue.events > max_events)
+			max_events = queue.events;
+		sleep_ns(BENCH_FEED_NS);
+	}
+
+	printf("%s:\n", priority ? "priority" : "fifo");
+	backlog_event_dispatcher_print_stats(&backlog, stdout);
+	stage->destroy(stage);
+	close(fds[1]);
+	pthread_join(thread, NULL);
+	close(fds[0]);
+
+	printf("queue gauges at most %llu frames, %llu events, %llu collapsed\n",
+		(unsigned long long)max_frames, (unsigned long long)max_events,
+		(unsigned long long)queue.frames_collapsed);
+	printf("consumer read %ld frames, ended with tracking IDs %d %d at x %d %d\n", consumer.frames,
+		consumer.tracking_id[0], consumer.tracking_id[1], consumer.x[0], consumer.x[1]);
+	return 0;
+}
+
+int main(void)
+{
+	return run(false) || run(true);
+}
@@ -0,0 +1,255 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+/*
+ * Cost and accuracy of the prediction stage, not run as a test.
+ *
+ *   bench_prediction                  ns per frame for 1 .. 10 moving contacts
+ *   bench_prediction dump lead_ms     how far the predicted positions of the
+ *                                     first input of a flight recorder dump
+ *                                     are from where the contacts went
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <linux/input.h>
+
+#include "prediction_event_dispatcher.h"
+#include "flight_recorder.h"
+
+static const int BENCH_FRAMES = 200000;
+static const int BENCH_FRAME_US = 8000;
+static const int BENCH_LEAD_MS = 16;
+
+// slots followed by the accuracy report
+#define REPORT_SLOTS 32
+#define REPORT_READ_RECORDS 4096
+
+struct slot_state
+{
+	bool down;
+	int x, y;
+};
+
+// positions after the frame that ended last
+static struct slot_state out_slots[REPORT_SLOTS];
+static int out_slot = 0;
+
+static bool follow_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	(void)base; // unused
+	for (int i = 0; i < count; ++i)
+	{
+		const struct input_event *ev = &events[i];
+		if (ev->type != EV_ABS)
+			continue;
+		if (ev->code == ABS_MT_SLOT)
+			out_slot = ev->value;
+		else if (out_slot >= 0 && out_slot < REPORT_SLOTS && ev->code == ABS_MT_POSITION_X)
+			out_slots[out_slot].x = ev->value;
+		else if (out_slot >= 0 && out_slot < REPORT_SLOTS && ev->code == ABS_MT_POSITION_Y)
+			out_slots[out_slot].y = ev->value;
+	}
+	return true;
+}
+
+static void follow_destroy(struct event_dispatcher *base)
+{
+	(void)base; // unused
+}
+
+static struct event_dispatcher *create_follower(void)
+{
+	struct event_dispatcher *follower = (struct event_dispatcher*)malloc(sizeof(*follower));
+	follower->dispatch = follow_dispatch;
+	follower->destroy = follow_destroy;
+	return follower;
+}
+
+static void set_event(struct input_event *ev, int64_t time_us, uint16_t type, uint16_t code, int32_t value)
+{
+	ev->time.tv_sec = time_us / 1000000;
+	ev->time.tv_usec = time_us % 1000000;
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static int benchmark(void)
+{
+	for (int contacts = 1; contacts <= 10; ++contacts)
+	{
+		static struct prediction_event_dispatcher prediction;
+		if (!prediction_event_dispatcher_create(&prediction, create_follower(), REPORT_SLOTS, BENCH_LEAD_MS, NULL, NULL))
+			return 1;
+		prediction.base.timed = true;
+		struct event_dispatcher *stage = &prediction.base.base;
+
+		// every contact circles at its own phase
+		for (int f = 0; f < BENCH_FRAMES; ++f)
+		{
+			struct input_event frame[4*10 + 1];
+			int n = 0;
+			const int64_t t = 1000000 + (int64_t)f*BENCH_FRAME_US;
+			for (int c = 0; c < contacts; ++c)
+			{
+				set_event(&frame[n++], t, EV_ABS, ABS_MT_SLOT, c);
+				if (f == 0)
+					set_event(&frame[n++], t, EV_ABS, ABS_MT_TRACKING_ID, c);
+				set_event(&frame[n++], t, EV_ABS, ABS_MT_POSITION_X, 1000 + c*100 + (int)(300*sin(f*0.05 + c)));
+				set_event(&frame[n++], t, EV_ABS, ABS_MT_POSITION_Y, 1000 + (int)(300*cos(f*0.05 + c)));
+			}
+			set_event(&frame[n++], t, EV_SYN, SYN_REPORT, 0);
+			stage->dispatch(stage, frame, n);
+		}
+
+		printf("%2d contacts: %4.0f ns/frame\n", contacts, (double)prediction.base.stats.ns / BENCH_FRAMES);
+		stage->destroy(stage);
+	}
+	return 0;
+}
+
+/**
+ * Input positions and predicted positions of every frame of the dump.
+ */
+struct report_frame
+{
+	int64_t time_us;
+	struct slot_state in[REPORT_SLOTS];
+	struct slot_state out[REPORT_SLOTS];
+};
+
+static int accuracy_report(const char *path, int lead_ms)
+{
+	struct flight_recorder_replay replay;
+	if (!flight_recorder_replay_open(&replay, path))
+		return 1;
+
+	static struct prediction_event_dispatcher prediction;
+	if (!prediction_event_dispatcher_create(&prediction, create_follower(), REPORT_SLOTS, lead_ms, NULL, NULL))
+		return 1;
+	struct event_dispatcher *stage = &prediction.base.base;
+
+	int frame_count = 0, frame_capacity = 1024;
+	struct report_frame *frames = (struct report_frame*)malloc(frame_capacity * sizeof(*frames));
+	struct slot_state in_slots[REPORT_SLOTS];
+	memset(in_slots, 0, sizeof(in_slots));
+	int in_slot = 0;
+
+	static struct flight_recorder_record records[REPORT_READ_RECORDS];
+	int n;
+	while ((n = flight_recorder_replay_read(&replay, records, REPORT_READ_RECORDS)) > 0)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			const struct input_event *ev = &records[i].event;
+			if (records[i].input != 0)
+				continue;
+
+			if (ev->type == EV_ABS && ev->code == ABS_MT_SLOT)
+				in_slot = ev->value;
+			else if (ev->type == EV_ABS && in_slot >= 0 && in_slot < REPORT_SLOTS)
+			{
+				if (ev->code == ABS_MT_TRACKING_ID)
+					in_slots[in_slot].down = ev->value >= 0;
+				else if (ev->code == ABS_MT_POSITION_X)
+					in_slots[in_slot].x = ev->value;
+				else if (ev->code == ABS_MT_POSITION_Y)
+					in_slots[in_slot].y = ev->value;
+			}
+
+			stage->dispatch(stage, ev, 1);
+
+			if (ev->type == EV_SYN && ev->code == SYN_REPORT)
+			{
+				if (frame_count == frame_capacity)
+				{
+					frame_capacity *= 2;
+					frames = (struct report_frame*)realloc(frames, frame_capacity * sizeof(*frames));
+				}
+				struct report_frame *frame = &frames[frame_count++];
+				frame->time_us = (int64_t)ev->time.tv_sec * 1000000 + ev->time.tv_usec;
+				memcpy(frame->in, in_slots, sizeof(in_slots));
+				memcpy(frame->out, out_slots, sizeof(out_slots));
+			}
+		}
+	}
+	flight_recorder_replay_close(&replay);
+	stage->destroy(stage);
+
+	// the target is where the input is lead_ms later, between the two frames around that time
+	double predicted_error = 0, unpredicted_error = 0;
+	long samples = 0;
+	int j = 0;
+	for (int f = 0; f < frame_count; ++f)
+	{
+		const int64_t target_us = frames[f].time_us + (int64_t)lead_ms * 1000;
+		while (j < frame_count - 1 && frames[j + 1].time_us <= target_us)
+			++j;
+		if (j >= frame_count - 1 || frames[j].time_us > target_us)
+			continue;
+
+		const double a = (double)(target_us - frames[j].time_us) / (frames[j + 1].time_us - frames[j].time_us);
+		for (int s = 0; s < REPORT_SLOTS; ++s)
+		{
+			const struct slot_state *now = &frames[f].in[s];
+			const struct slot_state *before = &frames[j].in[s], *after = &frames[j + 1].in[s];
+			if (!now->down || !before->down || !after->down)
+				continue;
+
+			const double x = before->x + a*(after->x - before->x);
+			const double y = before->y + a*(after->y - before->y);
+			predicted_error += hypot(frames[f].out[s].x - x, frames[f].out[s].y - y);
+			unpredicted_error += hypot(now->x - x, now->y - y);
+			++samples;
+		}
+	}
+	free(frames);
+
+	if (samples == 0)
+	{
+		fprintf(stderr, "%s: no contact to report on\n", path);
+		return 1;
+	}
+	printf("%s, lead %d ms: %ld samples in %d frames, mean error %.1f units predicted, %.1f units not predicted\n",
+			path, lead_ms, samples, frame_count, predicted_error / samples, unpredicted_error / samples);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 1)
+		return benchmark();
+	if (argc == 3)
+		return accuracy_report(argv[1], atoi(argv[2]));
+
+	fprintf(stderr, "Usage: %s [dump lead_ms]\n", argv[0]);
+	return 2;
+}
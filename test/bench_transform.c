@@ -0,0 +1,141 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+/*
+ * Cost of the transform stage, not run as a test.
+ *
+ *   bench_transform [slot_count]      ns per frame for 1 .. 32 moving contacts
+ *                                     on a device with slot_count (32) slots
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <linux/input.h>
+
+#include "transform_event_dispatcher.h"
+
+static const int BENCH_FRAMES = 200000;
+static const int BENCH_RUNS = 5;
+
+#define BENCH_MAX_CONTACTS 32
+
+static bool discard_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	(void)base; // unused
+	(void)events; // unused
+	(void)count; // unused
+	return true;
+}
+
+static void discard_destroy(struct event_dispatcher *base)
+{
+	(void)base; // unused
+}
+
+static struct event_dispatcher *create_discard(void)
+{
+	struct event_dispatcher *discard = (struct event_dispatcher*)malloc(sizeof(*discard));
+	discard->dispatch = discard_dispatch;
+	discard->destroy = discard_destroy;
+	return discard;
+}
+
+static void set_event(struct input_event *ev, uint16_t type, uint16_t code, int32_t value)
+{
+	memset(ev, 0, sizeof(*ev));
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+/**
+ * \brief Best ns/frame of BENCH_RUNS runs, every contact moves in every frame.
+ */
+static double measure(int contacts, int slot_count, const struct transform_config *config, const struct input_absinfo *absinfo)
+{
+	double best = 0;
+	for (int run = 0; run < BENCH_RUNS; ++run)
+	{
+		static struct transform_event_dispatcher transform;
+		if (!transform_event_dispatcher_create(&transform, create_discard(), slot_count, config, absinfo))
+			exit(1);
+		transform.base.timed = true;
+		struct event_dispatcher *stage = &transform.base.base;
+
+		for (int f = 0; f < BENCH_FRAMES; ++f)
+		{
+			struct input_event frame[4*BENCH_MAX_CONTACTS + 1];
+			int n = 0;
+			for (int c = 0; c < contacts; ++c)
+			{
+				set_event(&frame[n++], EV_ABS, ABS_MT_SLOT, c);
+				if (f == 0)
+					set_event(&frame[n++], EV_ABS, ABS_MT_TRACKING_ID, c);
+				set_event(&frame[n++], EV_ABS, ABS_MT_POSITION_X, 2048 + (int)(1000*sin(f*0.05 + c)));
+				set_event(&frame[n++], EV_ABS, ABS_MT_POSITION_Y, 2048 + (int)(1000*cos(f*0.05 + c)));
+			}
+			set_event(&frame[n++], EV_SYN, SYN_REPORT, 0);
+			stage->dispatch(stage, frame, n);
+		}
+
+		const double ns = (double)transform.base.stats.ns / BENCH_FRAMES;
+		if (run == 0 || ns < best)
+			best = ns;
+		stage->destroy(stage);
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	int slot_count = BENCH_MAX_CONTACTS;
+	if (argc > 2 || (argc == 2 && (slot_count = atoi(argv[1])) < BENCH_MAX_CONTACTS))
+	{
+		fprintf(stderr, "Usage: %s [slot_count of at least %d]\n", argv[0], BENCH_MAX_CONTACTS);
+		return 2;
+	}
+
+	struct input_absinfo absinfo[ABS_CNT];
+	memset(absinfo, 0, sizeof(absinfo));
+	absinfo[ABS_X].maximum = absinfo[ABS_MT_POSITION_X].maximum = 4095;
+	absinfo[ABS_Y].maximum = absinfo[ABS_MT_POSITION_Y].maximum = 4095;
+
+	// a slight rotation so that every coefficient is used
+	struct transform_config config;
+	transform_config_init(&config);
+	transform_config_parse_matrix(&config, "0.9,0.1,0.02,-0.1,0.9,0.05");
+	config.swap_axes = true;
+
+	static const int contacts[] = { 1, 2, 5, 10, 20, 32 };
+	for (unsigned i = 0; i < sizeof(contacts)/sizeof(contacts[0]); ++i)
+		printf("%2d contacts of %d slots: %4.0f ns/frame\n", contacts[i], slot_count,
+				measure(contacts[i], slot_count, &config, absinfo));
+	return 0;
+}
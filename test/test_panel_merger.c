@@ -0,0 +1,299 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/input.h>
+
+#include "panel_merger.h"
+
+static const int PANEL_COUNT = 3;
+static const int PANEL_SLOTS = 10;
+static const int PANEL_WIDTH = 4096;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+// events of the last merged frame
+static struct input_event merged[256];
+static int merged_count = 0;
+
+static bool capture_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	(void)base; // unused
+	CHECK(count <= (int)(sizeof(merged)/sizeof(merged[0])));
+	memcpy(merged, events, count*sizeof(*events));
+	merged_count = count;
+	return true;
+}
+
+static void capture_destroy(struct event_dispatcher *base)
+{
+	(void)base; // unused
+}
+
+/**
+ * Value of the last \a type \a code event in the last merged frame, \a missing if there is none.
+ */
+static int find(uint16_t type, uint16_t code, int missing)
+{
+	int value = missing;
+	for (int i = 0; i < merged_count; ++i)
+		if (merged[i].type == type && merged[i].code == code)
+			value = merged[i].value;
+	return value;
+}
+
+struct frame
+{
+	struct input_event events[16];
+	int count;
+};
+
+static void add(struct frame *frame, uint16_t type, uint16_t code, int32_t value)
+{
+	struct input_event *ev = &frame->events[frame->count++];
+	memset(ev, 0, sizeof(*ev));
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static void send(struct event_dispatcher *panel, struct frame *frame)
+{
+	add(frame, EV_SYN, SYN_REPORT, 0);
+	merged_count = 0;
+	CHECK(panel->dispatch(panel, frame->events, frame->count));
+	frame->count = 0;
+}
+
+/**
+ * Single-touch contact on a panel the way mtdev and the kernel pointer emulation report it.
+ */
+static void touch(struct event_dispatcher *panel, int tracking_id, int x, int y)
+{
+	struct frame frame = { .count = 0 };
+	add(&frame, EV_ABS, ABS_MT_SLOT, 0);
+	add(&frame, EV_ABS, ABS_MT_TRACKING_ID, tracking_id);
+	add(&frame, EV_ABS, ABS_MT_POSITION_X, x);
+	add(&frame, EV_ABS, ABS_MT_POSITION_Y, y);
+	add(&frame, EV_KEY, BTN_TOUCH, 1);
+	add(&frame, EV_ABS, ABS_X, x);
+	add(&frame, EV_ABS, ABS_Y, y);
+	send(panel, &frame);
+}
+
+static void move(struct event_dispatcher *panel, int x)
+{
+	struct frame frame = { .count = 0 };
+	add(&frame, EV_ABS, ABS_MT_POSITION_X, x);
+	add(&frame, EV_ABS, ABS_X, x);
+	send(panel, &frame);
+}
+
+static void release(struct event_dispatcher *panel)
+{
+	struct frame frame = { .count = 0 };
+	add(&frame, EV_ABS, ABS_MT_TRACKING_ID, -1);
+	add(&frame, EV_KEY, BTN_TOUCH, 0);
+	send(panel, &frame);
+}
+
+/**
+ * Start (\a tracking_id >= 0) or end a contact in \a slot of a panel that reports the finger count keys.
+ * \a released and \a pressed are the keys the panel changes, 0 for none.
+ */
+static void set_finger_count(struct event_dispatcher *panel, int slot, int tracking_id, int released, int pressed)
+{
+	struct frame frame = { .count = 0 };
+	add(&frame, EV_ABS, ABS_MT_SLOT, slot);
+	add(&frame, EV_ABS, ABS_MT_TRACKING_ID, tracking_id);
+	if (tracking_id >= 0)
+		add(&frame, EV_ABS, ABS_MT_POSITION_X, 100);
+	if (slot == 0)
+		add(&frame, EV_KEY, BTN_TOUCH, tracking_id >= 0);
+	if (released)
+		add(&frame, EV_KEY, released, 0);
+	if (pressed)
+		add(&frame, EV_KEY, pressed, 1);
+	send(panel, &frame);
+}
+
+int main(void)
+{
+	struct input_absinfo absinfo[ABS_CNT];
+	memset(absinfo, 0, sizeof(absinfo));
+	absinfo[ABS_MT_SLOT].maximum = PANEL_SLOTS - 1;
+	absinfo[ABS_X].maximum = absinfo[ABS_MT_POSITION_X].maximum = PANEL_WIDTH - 1;
+	absinfo[ABS_Y].maximum = absinfo[ABS_MT_POSITION_Y].maximum = 2047;
+
+	static struct panel_merger merger;
+	panel_merger_create(&merger);
+
+	struct event_dispatcher *panels[PANEL_COUNT];
+	for (int i = 0; i < PANEL_COUNT; ++i)
+	{
+		panels[i] = panel_merger_add_panel(&merger, absinfo, i*PANEL_WIDTH, 0);
+		CHECK(panels[i] != NULL);
+	}
+
+	struct event_dispatcher *capture = (struct event_dispatcher*)malloc(sizeof(*capture));
+	capture->dispatch = capture_dispatch;
+	capture->destroy = capture_destroy;
+	panel_merger_connect(&merger, capture);
+
+	CHECK(merger.absinfo[ABS_MT_SLOT].maximum == PANEL_COUNT*PANEL_SLOTS - 1);
+	CHECK(merger.absinfo[ABS_MT_POSITION_X].maximum == PANEL_COUNT*PANEL_WIDTH - 1);
+	CHECK(merger.absinfo[ABS_X].maximum == PANEL_COUNT*PANEL_WIDTH - 1);
+
+	// these two used to end up with the same merged tracking ID with three panels
+	touch(panels[0], 43691, 100, 200);
+	const int first_id = find(EV_ABS, ABS_MT_TRACKING_ID, -1);
+	CHECK(find(EV_ABS, ABS_MT_SLOT, 0) == 0);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == 100);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == 1);
+	CHECK(find(EV_ABS, ABS_X, -1) == 100);
+
+	touch(panels[1], 0, 300, 400);
+	const int second_id = find(EV_ABS, ABS_MT_TRACKING_ID, -1);
+	CHECK(first_id >= 0 && second_id >= 0 && first_id != second_id);
+	CHECK(find(EV_ABS, ABS_MT_SLOT, -1) == PANEL_SLOTS);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == PANEL_WIDTH + 300);
+	// already down, and the pointer stays with the panel touched first
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == -1);
+	CHECK(find(EV_ABS, ABS_X, -1) == -1);
+
+	// the same tracking ID on another panel is another contact
+	touch(panels[2], 0, 500, 600);
+	const int third_id = find(EV_ABS, ABS_MT_TRACKING_ID, -1);
+	CHECK(third_id >= 0 && third_id != first_id && third_id != second_id);
+	CHECK(find(EV_ABS, ABS_MT_SLOT, -1) == 2*PANEL_SLOTS);
+
+	move(panels[1], 310);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == PANEL_WIDTH + 310);
+	CHECK(find(EV_ABS, ABS_X, -1) == -1);
+
+	move(panels[0], 110);
+	CHECK(find(EV_ABS, ABS_MT_SLOT, -1) == 0);
+	CHECK(find(EV_ABS, ABS_X, -1) == 110);
+
+	// the pointer moves on to a panel that is still touched
+	release(panels[0]);
+	CHECK(find(EV_ABS, ABS_MT_TRACKING_ID, 0) == -1);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == -1);
+	CHECK(find(EV_ABS, ABS_X, -1) == PANEL_WIDTH + 310);
+	CHECK(find(EV_ABS, ABS_Y, -1) == 400);
+
+	move(panels[1], 320);
+	CHECK(find(EV_ABS, ABS_X, -1) == PANEL_WIDTH + 320);
+
+	release(panels[1]);
+	CHECK(find(EV_ABS, ABS_X, -1) == 2*PANEL_WIDTH + 500);
+	release(panels[2]);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == 0);
+
+	// and a new touch takes it again
+	touch(panels[1], 1, 50, 60);
+	CHECK(find(EV_ABS, ABS_X, -1) == PANEL_WIDTH + 50);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == 1);
+	const int fourth_id = find(EV_ABS, ABS_MT_TRACKING_ID, -1);
+	CHECK(fourth_id >= 0 && fourth_id != first_id && fourth_id != second_id && fourth_id != third_id);
+
+	panel_merger_destroy(&merger);
+
+	// the finger count keys count the contacts on all panels instead of being merged
+	static struct panel_merger counted;
+	panel_merger_create(&counted);
+	struct event_dispatcher *left = panel_merger_add_panel(&counted, absinfo, 0, 0);
+	struct event_dispatcher *right = panel_merger_add_panel(&counted, absinfo, PANEL_WIDTH, 0);
+	CHECK(left != NULL && right != NULL);
+	struct event_dispatcher *counted_capture = (struct event_dispatcher*)malloc(sizeof(*counted_capture));
+	counted_capture->dispatch = capture_dispatch;
+	counted_capture->destroy = capture_destroy;
+	panel_merger_connect(&counted, counted_capture);
+
+	set_finger_count(left, 0, 10, 0, BTN_TOOL_FINGER);
+	CHECK(find(EV_KEY, BTN_TOOL_FINGER, -1) == 1);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == 1);
+
+	set_finger_count(right, 0, 20, 0, BTN_TOOL_FINGER);
+	CHECK(find(EV_KEY, BTN_TOOL_FINGER, -1) == 0);
+	CHECK(find(EV_KEY, BTN_TOOL_DOUBLETAP, -1) == 1);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == -1);
+
+	set_finger_count(left, 1, 11, BTN_TOOL_FINGER, BTN_TOOL_DOUBLETAP);
+	CHECK(find(EV_KEY, BTN_TOOL_DOUBLETAP, -1) == 0);
+	CHECK(find(EV_KEY, BTN_TOOL_TRIPLETAP, -1) == 1);
+
+	set_finger_count(right, 0, -1, BTN_TOOL_FINGER, 0);
+	CHECK(find(EV_KEY, BTN_TOOL_TRIPLETAP, -1) == 0);
+	CHECK(find(EV_KEY, BTN_TOOL_DOUBLETAP, -1) == 1);
+	CHECK(find(EV_KEY, BTN_TOOL_FINGER, -1) == -1);
+
+	// the left panel only moves from two fingers to one
+	set_finger_count(left, 1, -1, BTN_TOOL_DOUBLETAP, BTN_TOOL_FINGER);
+	CHECK(find(EV_KEY, BTN_TOOL_DOUBLETAP, -1) == 0);
+	CHECK(find(EV_KEY, BTN_TOOL_FINGER, -1) == 1);
+
+	set_finger_count(left, 0, -1, BTN_TOOL_FINGER, 0);
+	CHECK(find(EV_KEY, BTN_TOOL_FINGER, -1) == 0);
+	CHECK(find(EV_KEY, BTN_TOUCH, -1) == 0);
+	panel_merger_destroy(&counted);
+
+	// type A panels get the 32 slots mtdev emulates, the stages after the merger track at most PANEL_MERGER_MAX_SLOTS
+	static struct panel_merger large;
+	panel_merger_create(&large);
+	struct input_absinfo type_a[ABS_CNT];
+	memcpy(type_a, absinfo, sizeof(type_a));
+	type_a[ABS_MT_SLOT].maximum = 0;
+	for (int i = 0; i < PANEL_MERGER_MAX_SLOTS/32; ++i)
+		CHECK(panel_merger_add_panel(&large, type_a, 0, 0) != NULL);
+	CHECK(large.absinfo[ABS_MT_SLOT].maximum == PANEL_MERGER_MAX_SLOTS - 1);
+	panel_merger_destroy(&large);
+
+	static struct panel_merger too_large;
+	panel_merger_create(&too_large);
+	absinfo[ABS_MT_SLOT].maximum = PANEL_MERGER_MAX_SLOTS/2;
+	CHECK(panel_merger_add_panel(&too_large, absinfo, 0, 0) != NULL);
+	CHECK(panel_merger_add_panel(&too_large, absinfo, 0, 0) == NULL);
+	panel_merger_destroy(&too_large);
+
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*****************************************************************************
+ *
+ * mt-translator - Multitouch Protocol Translation Tool (MIT license)
+ *
+ * Copyright (C) 2012 David Kozub <zub@linux.fjfi.cvut.cz>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <linux/input.h>
+
+#include "prediction_event_dispatcher.h"
+
+static const int FRAME_US = 8000;
+static const int LEAD_MS = 16;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+// events of the last frame passed on, none if the stage dropped it
+static struct input_event passed[SLOT_FILTER_MAX_OUT_EVENTS];
+static int passed_count = 0;
+
+static bool capture_dispatch(struct event_dispatcher *base, const struct input_event *events, int count)
+{
+	(void)base; // unused
+	CHECK(count <= SLOT_FILTER_MAX_OUT_EVENTS);
+	memcpy(passed, events, count*sizeof(*events));
+	passed_count = count;
+	return true;
+}
+
+static void capture_destroy(struct event_dispatcher *base)
+{
+	(void)base; // unused
+}
+
+static struct event_dispatcher *create_capture(void)
+{
+	struct event_dispatcher *capture = (struct event_dispatcher*)malloc(sizeof(*capture));
+	capture->dispatch = capture_dispatch;
+	capture->destroy = capture_destroy;
+	return capture;
+}
+
+/**
+ * Value of the last \a type \a code event in the last frame passed on, \a missing if there is none.
+ */
+static int find(uint16_t type, uint16_t code, int missing)
+{
+	int value = missing;
+	for (int i = 0; i < passed_count; ++i)
+		if (passed[i].type == type && passed[i].code == code)
+			value = passed[i].value;
+	return value;
+}
+
+struct frame
+{
+	struct input_event events[16];
+	int count;
+	int64_t time_us;
+};
+
+static void add(struct frame *frame, uint16_t type, uint16_t code, int32_t value)
+{
+	struct input_event *ev = &frame->events[frame->count++];
+	ev->time.tv_sec = frame->time_us / 1000000;
+	ev->time.tv_usec = frame->time_us % 1000000;
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static void send(struct event_dispatcher *stage, struct frame *frame)
+{
+	add(frame, EV_SYN, SYN_REPORT, 0);
+	passed_count = 0;
+	CHECK(stage->dispatch(stage, frame->events, frame->count));
+	frame->count = 0;
+}
+
+/**
+ * A frame of \a slot at \a x, \a y, starting the contact if \a tracking_id >= 0.
+ */
+static void contact(struct event_dispatcher *stage, int64_t time_us, int slot, int tracking_id, int x, int y)
+{
+	struct frame frame = { .count = 0, .time_us = time_us };
+	add(&frame, EV_ABS, ABS_MT_SLOT, slot);
+	if (tracking_id >= 0)
+		add(&frame, EV_ABS, ABS_MT_TRACKING_ID, tracking_id);
+	add(&frame, EV_ABS, ABS_MT_POSITION_X, x);
+	add(&frame, EV_ABS, ABS_MT_POSITION_Y, y);
+	send(stage, &frame);
+}
+
+static void lift(struct event_dispatcher *stage, int64_t time_us, int slot)
+{
+	struct frame frame = { .count = 0, .time_us = time_us };
+	add(&frame, EV_ABS, ABS_MT_SLOT, slot);
+	add(&frame, EV_ABS, ABS_MT_TRACKING_ID, -1);
+	send(stage, &frame);
+}
+
+static void test_linear_motion(void)
+{
+	static struct prediction_event_dispatcher prediction;
+	CHECK(prediction_event_dispatcher_create(&prediction, create_capture(), 10, LEAD_MS, NULL, NULL));
+	struct event_dispatcher *stage = &prediction.base.base;
+
+	// 10 units per frame, 20 units per lead
+	int64_t t = 1000000;
+	contact(stage, t, 0, 1, 100, 500);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == 100);
+	contact(stage, t += FRAME_US, 0, -1, 110, 500);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == 110);
+	for (int x = 120; x <= 160; x += 10)
+	{
+		contact(stage, t += FRAME_US, 0, -1, x, 500);
+		CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == x + 20);
+		// the position sent last is not repeated
+		CHECK(find(EV_ABS, ABS_MT_POSITION_Y, -1) == -1);
+	}
+
+	// lifted where it really was, not where it was predicted to go
+	lift(stage, t += FRAME_US, 0);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == 160);
+	CHECK(find(EV_ABS, ABS_MT_TRACKING_ID, 0) == -1);
+
+	// nothing but SYN_REPORT is not passed on
+	struct frame frame = { .count = 0, .time_us = t += FRAME_US };
+	send(stage, &frame);
+	CHECK(passed_count == 0);
+
+	stage->destroy(stage);
+}
+
+static void test_slots_beyond_count(void)
+{
+	static struct prediction_event_dispatcher prediction;
+	CHECK(prediction_event_dispatcher_create(&prediction, create_capture(), 2, LEAD_MS, NULL, NULL));
+	struct event_dispatcher *stage = &prediction.base.base;
+
+	// slot 2 is not tracked and passes through untouched
+	int64_t t = 1000000;
+	contact(stage, t, 2, 1, 100, 500);
+	for (int x = 110; x <= 130; x += 10)
+		contact(stage, t += FRAME_US, 2, -1, x, 500);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, -1) == 130);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_Y, -1) == 500);
+
+	stage->destroy(stage);
+}
+
+static void test_large_step(void)
+{
+	static struct input_absinfo range;
+	memset(&range, 0, sizeof(range));
+	range.maximum = 4095;
+
+	// samples a microsecond apart make the step overflow an int
+	static struct prediction_event_dispatcher unclamped, clamped;
+	CHECK(prediction_event_dispatcher_create(&unclamped, create_capture(), 10, PREDICTION_MAX_LEAD_MS, NULL, NULL));
+	CHECK(prediction_event_dispatcher_create(&clamped, create_capture(), 10, PREDICTION_MAX_LEAD_MS, &range, &range));
+
+	for (int i = 0; i < 3; ++i)
+		contact(&unclamped.base.base, 1000000 + i, 0, i == 0 ? 1 : -1, i*1000000, -i*1000000);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, 0) == INT_MAX);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_Y, 0) == INT_MIN);
+
+	for (int i = 0; i < 3; ++i)
+		contact(&clamped.base.base, 1000000 + i, 0, i == 0 ? 1 : -1, i*2000, 4000 - i*2000);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_X, 0) == 4095);
+	CHECK(find(EV_ABS, ABS_MT_POSITION_Y, -1) == 0);
+
+	unclamped.base.base.destroy(&unclamped.base.base);
+	clamped.base.base.destroy(&clamped.base.base);
+}
+
+static void test_create(void)
+{
+	static struct prediction_event_dispatcher prediction;
+	struct event_dispatcher *capture = create_capture();
+	CHECK(!prediction_event_dispatcher_create(&prediction, capture, 10, -1, NULL, NULL));
+	CHECK(!prediction_event_dispatcher_create(&prediction, capture, 10, PREDICTION_MAX_LEAD_MS + 1, NULL, NULL));
+	CHECK(!prediction_event_dispatcher_create(&prediction, capture, SLOT_FILTER_MAX_SLOTS + 1, LEAD_MS, NULL, NULL));
+	free(capture);
+}
+
+int main(void)
+{
+	test_linear_motion();
+	test_slots_beyond_count();
+	test_large_step();
+	test_create();
+
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? 1 : 0;
+}